@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+# Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+# Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+# Compile-time benchmarks for monadplay.hpp. Every suite generates translation
+# units of increasing size and reports, for every (suite, size, standard), the
+# best wall-clock compile time out of "--repeat" runs and the peak resident
+# memory of the compiler, so that library changes can be judged by build cost:
+#
+#   kleisli  a chain of "size" binds, each through a distinct arrow, so that
+#            every link is a fresh instantiation of "prod"
+#   closure  "size" nested generic closures built with "par" and "dot" (the
+#            way "dx_sqr" is) and finally mapped over a list with "fmap"
+#   types    a short chain of binds and a fold repeated over "size" distinct
+#            element types
+#
+#   python3 bench/compile_time.py --suites kleisli --sizes 10,100,1000
+#   python3 bench/compile_time.py --codegen --stds c++14 -- -O2
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+PROLOGUE = [ '#include "monadplay.hpp"'
+           , 'using namespace monadplay;' ]
+
+
+def kleisli(size):
+    lines = PROLOGUE + [ 'int main() {'
+                       , '    auto m0 = unit(int64_t{1});' ]
+    for i in range(1, size + 1):
+        lines.append( '    auto m%d = prod([](int64_t x) { return unit(x + %d); }, m%d);'
+                    % (i, i, i - 1) )
+    lines.append( '    return static_cast<int>(foldl(std::plus<int64_t>{}, m%d, int64_t{}) & 1);'
+                % size )
+    lines.append('}')
+    return lines
+
+
+def closure(size):
+    lines = PROLOGUE + [ 'int main() {'
+                       , '    auto dif = [](auto x, auto y) { return x - y; };'
+                       , '    auto sqr = [](auto x) { return x * x; };'
+                       , '    auto par = [](auto x, auto y) { return [=](auto z) { return x(z,y); }; };'
+                       , '    auto dot = [](auto x, auto y) { return [=](auto z) { return x(y(z)); }; };'
+                       , '    auto c0 = dot(sqr, par(dif, int64_t{1}));' ]
+    for i in range(1, size + 1):
+        lines.append( '    auto c%d = dot(par(dif, int64_t{%d}), c%d);' % (i, i, i - 1) )
+    lines += [ '    std::list<int64_t> ls(16);'
+             , '    std::iota(ls.begin(), ls.end(), 0);'
+             , '    return static_cast<int>(foldl(std::plus<int64_t>{}, fmap(c%d, ls), int64_t{}) & 1);'
+               % size
+             , '}' ]
+    return lines
+
+
+def types(size):
+    lines = PROLOGUE + [ 'template<int I> struct element {'
+                       , '    int64_t v;'
+                       , '    element operator+(element o) const { return {v + o.v}; }'
+                       , '};'
+                       , 'template<int I> int64_t chain() {'
+                       , '    auto f = [](element<I> x) { return unit(x + x); };'
+                       , '    auto g = [](element<I> x) { return unit(x + element<I>{I}); };'
+                       , '    auto m = prod(g, prod(f, unit(element<I>{1})));'
+                       , '    return foldl([](element<I> a, element<I> b) { return a + b; }'
+                       , '                , m, element<I>{0}).v;'
+                       , '}'
+                       , 'int main() {'
+                       , '    int64_t s = 0;' ]
+    for i in range(size):
+        lines.append('    s += chain<%d>();' % i)
+    lines += [ '    return static_cast<int>(s & 1);'
+             , '}' ]
+    return lines
+
+
+SUITES = { 'kleisli' : (kleisli, '10,100,1000')
+         , 'closure' : (closure, '10,50,100')
+         , 'types'   : (types,   '1,10,100') }
+
+
+def compile_once(cxx, std, path, flags, codegen):
+    stage = ['-c', '-o', os.devnull] if codegen else ['-fsyntax-only']
+    cmd = [cxx, '-std=' + std, '-I', ROOT] + stage + flags + [path]
+    start = time.perf_counter()
+    proc = subprocess.Popen(cmd)
+    _, status, usage = os.wait4(proc.pid, 0)
+    seconds = time.perf_counter() - start
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if proc.returncode != 0:
+        raise subprocess.CalledProcessError(proc.returncode, cmd)
+    # ru_maxrss covers the driver and the compiler proper it waited for (KiB).
+    return seconds, usage.ru_maxrss / 1024.0
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('--cxx', default=os.environ.get('CXX', 'c++'))
+    ap.add_argument('--suites', default=','.join(sorted(SUITES)))
+    ap.add_argument('--sizes', help='override the sizes of every suite')
+    ap.add_argument('--stds', default='c++14,c++20')
+    ap.add_argument('--repeat', type=int, default=3)
+    ap.add_argument('--codegen', action='store_true',
+                    help='generate code (-c) instead of stopping after -fsyntax-only')
+    ap.add_argument('flags', nargs='*', help='extra compiler flags')
+    args = ap.parse_args()
+
+    print('%-8s %6s %-7s %10s %10s' % ('suite', 'size', 'std', 'seconds', 'peak MiB'))
+    with tempfile.TemporaryDirectory() as tmp:
+        for suite in args.suites.split(','):
+            generate, sizes = SUITES[suite]
+            for size in [int(n) for n in (args.sizes or sizes).split(',')]:
+                path = os.path.join(tmp, '%s_%d.cc' % (suite, size))
+                with open(path, 'w') as f:
+                    f.write('\n'.join(generate(size)) + '\n')
+                for std in args.stds.split(','):
+                    runs = [ compile_once(args.cxx, std, path, args.flags, args.codegen)
+                             for _ in range(args.repeat) ]
+                    print( '%-8s %6d %-7s %10.3f %10.1f'
+                         % ( suite, size, std
+                           , min(r[0] for r in runs), max(r[1] for r in runs) ) )
+                    sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
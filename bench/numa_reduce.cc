@@ -0,0 +1,52 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#include "monadplay_scheduler.hpp"
+
+#include <future>
+
+// Throughput of "fmap_async" followed by "reduce_async" under each placement
+// of the scheduler's workers: free-floating, and pinned across NUMA nodes. On a
+// single node machine the figures should only differ by noise.
+//
+//   c++ -std=c++14 -O2 -pthread -I. bench/numa_reduce.cc -o numa_reduce
+//   ./numa_reduce [elements] [rounds]
+
+using namespace monadplay;
+
+int main(int argc, char ** argv) {
+    std::size_t const n = argc > 1 ? std::stoul(argv[1]) : std::size_t{1} << 22;
+    int const rounds = argc > 2 ? std::stoi(argv[2]) : 4;
+    std::size_t const grain = 1 << 16;
+
+    std::list<int64_t> ls(n);
+    std::iota(ls.begin(), ls.end(), 0);
+
+    std::vector<int> cpus = numa_cpu_order();
+    printf("%zu elements, %d rounds, %zu cores visible\n", n, rounds, cpus.size());
+
+    auto twice = [](int64_t x) { return x + x; };
+    auto sum = [](int64_t x, int64_t y) { return x + y; };
+
+    struct { char const * name; placement where; } runs[] = {
+        { "unpinned", placement{false} },
+        { "pinned",   placement{true } },
+    };
+    for(auto & r : runs) {
+        scheduler s(cpus.empty() ? std::thread::hardware_concurrency() : cpus.size(), r.where);
+        bool ok = true;
+        auto start = std::chrono::steady_clock::now();
+        for(int i = 0; i < rounds; ++i) {
+            std::promise<int64_t> result;
+            fmap_async(s, twice, ls, [&](std::list<int64_t> y) {
+                reduce_async( s, sum, std::move(y), int64_t{}
+                            , [&](int64_t r) { result.set_value(r); }, grain );
+            }, grain);
+            ok = ok && result.get_future().get() == int64_t(n) * int64_t(n - 1);
+        }
+        std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+        printf( "%-10s %8.1f M elements/s (sum %s, %zu of %zu workers pinned)\n", r.name
+              , rounds * n / t.count() / 1e6, ok ? "ok" : "wrong", s.pinned(), s.size() );
+    }
+    return {};
+}
@@ -1,79 +1,32 @@
 // Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
 // Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
 
-#include <list>
-#include <type_traits>
-#include <cstdio>
-#include <algorithm>
+#include "monadplay.hpp"
+#include "monadplay_bitset.hpp"
+#include "monadplay_by_key.hpp"
+#include "monadplay_fetch.hpp"
+#include "monadplay_lazy.hpp"
+#include "monadplay_memo.hpp"
+#include "monadplay_mpsc.hpp"
+#include "monadplay_progression.hpp"
+#include "monadplay_scheduler.hpp"
+#include "monadplay_sequence.hpp"
+#include "monadplay_simd.hpp"
+#include "monadplay_stm.hpp"
+#include "monadplay_stream.hpp"
+#include "monadplay_zipper.hpp"
 
-// The purpose of this code is purely educational, so that the relations between
-// fundamental operations in functional programming constructs become clear to
-// the reader versed in C++; it can be written in many different ways but since
-// I was utterly bored I just picked one at random. This code requires C++14
-// because of std::result_of_t, generic lambdas, though can be adapted to C++11
-// but we are already heading towards to C++17. A std::list will be used for
-// the examples and the purpose here is to see how far one can get  with the
-// complexity of the constructs involved as well as whether certain laws are
-// respected. Of course, it is all about the Monads.
+#include <future>
+#include <memory>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <vector>
 
-// NOTE: Just compile with -std=c++14
+// A walk through the constructs of monadplay.hpp: the monadic laws are checked
+// first, then a few folds are verified against known closed forms.
 
-/*
- * From Saunders Mac Lane's "Categories for the Working Mathematician", 1971:
- * 
- * "All told, a monad in X is just a monoid in the category of endofunctors of
- *  X, with product × replaced by composition of endofunctors and unit set by
- *  the identity endofunctor."
- * 
- * C++'s design is quite unhelpful in dealing with such constructs but it is
- * worth a try to understand what Saunders is talking about in coding terms.
- * 
- */
-
-/* Step 1: define "unit" as *unary* operation for a std::list<X>; it represents
-           the "identity endofunctor", essentially the constructor for a list.
-*/
-template<typename X> 
-std::list<X> unit(X const & x)
-{ return std::list<X>{x}; }
-
-/* Step 2: define "prod" operation for a std::list<X>; if empty, returns empty,
-           otherwise the idiomatic way of shifting around items in a list is
-           deployed through a lambda (but could also be without it). Actually,
-           "prod" is the infamous "bind" and beware that unlike "unit", it is
-           a **binary** operation. Notice that "prod" is dedicated to std::list
-           **endofunctor** composition; notice the **recursion** involved.
-*/
-template<typename F, typename X>
-std::result_of_t<F(X)> prod(F f, std::list<X> x) {
-    return (x.empty())
-        ? std::result_of_t<F(X)>{}
-        : [&]() { std::result_of_t<F(X)> y{ f(x.front()) };
-                  x.pop_front();
-                  y.splice(y.end(), prod(f,x));
-                  return y;
-                } ();
-}
-
-/* Step 4: "join" (or "flatten") can be defined in terms of prod. */
-template<typename X>
-std::list<X> join(std::list<std::list<X>> const& x) {
-    return prod([](auto y) { return y; }, x);
-}
-
-/* Step 5: "fmap" can be defined in terms of prod, unit */
-template<typename F, typename X>
-std::list<X> fmap(F f, std::list<X> const & x) {
-    return prod([=](auto y) { return unit(f(y)); }, x);
-}
-
-/* Step 6: "foldl" because it is quite easy to do anyway */
-template<typename F, typename X, typename Y>
-Y foldl(F f, std::list<X> const & m, Y y) {
-    for(auto && i : m)
-        y = f(y, i);
-    return y;
-}
+using namespace monadplay;
 
 int main () {
     
@@ -140,7 +93,13 @@ int main () {
         return s && law1(x) && law2(x) && law3(x);
     };
     
-    if(foldl(laws_check, ls, true)) {
+    /* The law checks are the long-running part when "ls" grows large; given
+       a path in MONADPLAY_CHECKPOINT they go through the checkpointed fold,
+       so that a run killed half-way resumes where it was the next time.
+    */
+    char const * ckpt = std::getenv("MONADPLAY_CHECKPOINT");
+    if( ckpt ? foldl_checkpoint(laws_check, ls, true, ckpt, 0x6c617773 /* "laws" */)
+             : foldl(laws_check, ls, true) ) {
         printf("\nleft identity, right identity, associativity laws valid.\n");
         printf("... so, it is a monad after all!\n");
         printf("... so, we can now start playing and pay the consequences!\n");
@@ -196,9 +155,523 @@ int main () {
     auto sigma_dx2 =
         [=](auto & x) { return foldl(sum,prod(par(dx_sqr,x),x), int64_t{}); };
     
-    printf( "Sum of squares vs square of sums (provided no overflow): %s\n\n"
+    printf( "Sum of squares vs square of sums (provided no overflow): %s\n"
           , (ls.size() * sigma_squares(ls) - sigma_sqr(ls) == sigma_dx2(ls) / 2)
                 ? "true" : "false (you overflowed it!)" );
+    
+    /* Task 5: a nondeterministic search that doubles its candidates at every
+               level would need 2^40 results; give it 50ms and see it stop
+               with a partial answer instead of running forever.
+     */
+    cancel_token deadline(std::chrono::milliseconds(50));
+    std::function<std::list<int64_t>(int64_t, int)> search
+        = [&](int64_t x, int d) {
+            return d == 0
+                ? unit(x)
+                : prod( [&](int64_t y) { return search(y, d - 1); }
+                      , std::list<int64_t>{2 * x, 2 * x + 1}, deadline );
+        };
+    auto found = search(1, 40);
+    printf( "Runaway search cancelled at deadline with %zu partial results: %s\n"
+          , found.size(), deadline.cancelled() ? "true" : "false" );
+
+    // On the scheduler, chunks starting after cancellation are skipped.
+    cancel_token stopped;
+    stopped.cancel();
+    std::promise<int64_t> skipped;
+    {
+        scheduler workers(2);
+        reduce_async( workers, sum, ls, int64_t{}
+                    , [&](int64_t r) { skipped.set_value(r); }, 10, nullptr, &stopped );
+    }
+    printf( "Parallel reduce skipped every chunk once cancelled: %s\n"
+          , skipped.get_future().get() == 0 ? "true" : "false" );
+  
+    /* Task 6: four producers append the integers 0,1,...,99999 to a shared
+               sequence, yielding now and then so that even one core
+               interleaves them, while the main thread keeps counting its
+               stable prefix over and over; every count must be at least the
+               one before and at most the final one, and once the producers
+               are done, the fold must be the full closed form.
+     */
+    mpsc_list<int64_t> shared;
+    std::atomic<int> producing{4};
+    std::vector<std::thread> producers;
+    for(int64_t p = 0; p < 4; ++p)
+        producers.emplace_back([&shared, &producing, p]() {
+            for(int64_t i = p; i < 100000; i += 4) {
+                shared.push(i);
+                if(i % 4096 < 4)
+                    std::this_thread::yield();
+            }
+            producing.fetch_sub(1);
+        });
+    auto count = [](int64_t n, int64_t) { return n + 1; };
+    int64_t partial = 0;
+    bool growing = true;
+    std::size_t passes = 0;
+    do {
+        int64_t now = foldl(count, shared, int64_t{});
+        growing = growing && now >= partial;
+        partial = now;
+        ++passes;
+        std::this_thread::yield();
+    } while(producing.load() > 0);
+    for(auto & t : producers)
+        t.join();
+    printf( "Lock-free sequence folded while appended (%zu passes, last partial %lld): %s\n"
+          , passes, static_cast<long long>(partial)
+          , growing && partial <= foldl(count, shared, int64_t{})
+            && foldl(count, shared, int64_t{}) == 100000
+            && foldl(sum, prod(g, shared), int64_t{}) == 2*sn1(int64_t{99999})
+                ? "true" : "false" );
+  
+    /* Task 7: an event source pushes 0,1,2,...,99999 through a channel that
+               never holds more than 16 of them, while a stream doubles them
+               and keeps a running sum; its last output is the closed form.
+     */
+    channel<int64_t> events(16);
+    std::thread source([&events]() {
+        for(int64_t i = 0; i < 100000; ++i)
+            events.push(i);
+        events.close();
+    });
+    int64_t running = 0;
+    foldl( sum
+         , prod([](int64_t x) { return stream<int64_t>::unit(x + x); }
+               , from_channel(events))
+         , int64_t{} )
+        .subscribe([&](int64_t s) { running = s; return true; });
+    source.join();
+    printf( "Stream through a bounded channel summed doubles: %s\n"
+          , running == 2*sn1(int64_t{99999}) ? "true" : "false" );
+  
+    /* Task 8: a thousand small pipelines at once on a handful of workers; each
+               doubles 0,1,2,...,99 in chunks of 10 and reduces the result,
+               both steps resuming their continuation instead of waiting.
+     */
+    std::atomic<int> pipelines{1000}, correct{0};
+    std::promise<void> all_done;
+    {
+        scheduler workers(4);
+        for(int i = 0; i < 1000; ++i)
+            prod_async(workers, g, ls, [&](std::list<int64_t> y) {
+                reduce_async(workers, sum, std::move(y), int64_t{}, [&](int64_t r) {
+                    correct += r == 2*sn1(int64_t(ls.size()) - 1);
+                    if(--pipelines == 0)
+                        all_done.set_value();
+                }, 10);
+            }, 10);
+        all_done.get_future().wait();
+    }
+    printf( "A thousand pipelines on a work-stealing scheduler: %s\n"
+          , correct == 1000 ? "true" : "false" );
+  
+    /* Task 9: four threads move 10000 units each from one shared counter to
+               another, one unit per transaction; no unit may go missing, and
+               each of the three binds counts every time a transaction (or a
+               retry of it) runs it.
+     */
+    tvar<int64_t> from(40000), to(0);
+    auto transfer =
+        prod([&](int64_t x) {
+            return prod([&](int64_t) {
+                return prod([&](int64_t y) { return write_tvar(to, y + 1); }
+                           , read_tvar(to));
+            }, write_tvar(from, x - 1));
+        }, read_tvar(from));
+    uint64_t binds_before = stats::snapshot()[binds];
+    std::vector<std::thread> tellers;
+    for(int t = 0; t < 4; ++t)
+        tellers.emplace_back([&transfer]() {
+            for(int i = 0; i < 10000; ++i)
+                atomically(transfer);
+        });
+    for(auto & t : tellers)
+        t.join();
+    printf( "Concurrent transactions conserved the total: %s\n"
+          , from.value.load() == 0 && to.value.load() == 40000
+            && stats::snapshot()[binds] - binds_before >= 3 * 40000 ? "true" : "false" );
+  
+    /* Task 10: every element of 0,1,2,...,99 looks up the square of its last
+                digit in a key-value store; a hundred lookups must reach the
+                store as one batch of ten distinct keys.
+     */
+    std::map<int64_t, int64_t> store;
+    for(int64_t i = 0; i < 10; ++i)
+        store[i] = sqr(i);
+    std::size_t keys_asked = 0;
+    data_source<int64_t, int64_t> records([&](std::vector<int64_t> const & keys) {
+        std::map<int64_t, int64_t> found;
+        for(auto k : keys)
+            found[k] = store.at(k);
+        keys_asked += keys.size();
+        return found;
+    });
+    auto squares = prod( [&](std::list<int64_t> y) {
+                             return fetch<int64_t>::unit(foldl(sum, y, int64_t{}));
+                         }
+                       , fetch_all([&](int64_t x) { return lookup(records, x % 10); }, ls) );
+    int64_t looked_up = run_fetch(squares, records);
+    printf( "Hundred lookups served by %zu batch of %zu keys: %s\n"
+          , records.batches, keys_asked
+          , looked_up == 10 * sn2(int64_t{9})
+            && records.batches == 1 && keys_asked == 10 ? "true" : "false" );
+  
+    /* Task 11: one expensive sum shared by two pipelines that are forced from
+                two threads at once; it must be computed exactly once.
+     */
+    std::atomic<int> evaluations{0};
+    lazy<int64_t> total([&]() { ++evaluations; return foldl(sum, ls, int64_t{}); });
+    auto doubled = prod([](int64_t s) { return lazy<int64_t>::unit(s + s); }, total);
+    auto squared = fmap(sqr, total);
+    std::thread first([&]() { force(doubled); });
+    force(squared);
+    first.join();
+    printf( "Shared lazy sub-pipeline evaluated once: %s\n"
+          , evaluations == 1
+            && force(doubled) == 2*sn1(int64_t(ls.size()) - 1)
+            && force(squared) == sqr(sn1(int64_t(ls.size()) - 1)) ? "true" : "false" );
+  
+    /* Task 12: the partitions of 100, counted with the recursion on the largest
+                part, p(n, k) = p(n, k - 1) + p(n - k, k), written as binds; its
+                tree has millions of leaves yet only ~5000 distinct subproblems.
+                A table bounded to 1024 slots must reach the same count.
+     */
+    typedef memo<int64_t, int64_t> counting;
+    auto partitions = memo_fix<int64_t, int64_t>([](auto self, int64_t key) {
+        int64_t n = key / 1024, k = key % 1024;
+        if(n == 0 || k == 1)
+            return counting::unit(1);
+        if(k > n)
+            return self(n * 1024 + n);
+        return prod([=](int64_t a) {
+            return prod( [=](int64_t b) { return counting::unit(a + b); }
+                       , self((n - k) * 1024 + k));
+        }, self(n * 1024 + k - 1));
+    });
+    memo_table<int64_t, int64_t> unbounded, bounded(1024);
+    printf( "Partitions of 100 through memoised binds: %s\n"
+          , partitions(100 * 1024 + 100).run(unbounded) == 190569292
+            && partitions(100 * 1024 + 100).run(bounded) == 190569292
+                ? "true" : "false" );
+  
+    /* Task 13: a moving sum of radius 2 and a central difference over
+               0,1,2,...,99, each computed by a stencil's sliding passes and by
+               extending a plain function of the neighbourhood; they must agree.
+     */
+    zipper<int64_t> line(std::vector<int64_t>(ls.begin(), ls.end()));
+    auto window = extend(stencil<int64_t, 2>{{{1, 1, 1, 1, 1}}}, line);
+    auto slope = extend(stencil<int64_t, 1>{{{-1, 0, 1}}}, line);
+    auto window_by_hand = extend([](zipper<int64_t> const & z) {
+        return z.at(-2) + z.at(-1) + z.extract() + z.at(1) + z.at(2);
+    }, line);
+    auto slope_by_hand = extend([](zipper<int64_t> const & z) {
+        return z.at(1) - z.at(-1);
+    }, line);
+    printf( "Stencil passes agree with extend on neighbourhoods: %s\n"
+          , window.storage() == window_by_hand.storage()
+            && slope.storage() == slope_by_hand.storage()
+            && extract(window.refocus(50)) == 5 * 50 ? "true" : "false" );
+  
+    /* Task 14: dividing 100 by every element fails as a whole when one of them
+               is zero; squaring the elements of 0,1,...,7 on their own threads
+               and collecting the results must give the sum of squares.
+     */
+    auto divide = [](int64_t x) {
+        return x == 0 ? std::list<int64_t>{} : unit(100 / x);
+    };
+    auto launched = traverse([](int64_t x) {
+        return std::async(std::launch::async, [x]() { return x * x; });
+    }, std::list<int64_t>(ls.begin(), std::next(ls.begin(), 8)));
+    std::vector<int64_t> squares_of_eight = launched.get();
+    printf( "Traversals with optional and parallel effects: %s\n"
+          , traverse(divide, ls).empty()
+            && traverse(divide, std::list<int64_t>(std::next(ls.begin()), ls.end())).size() == 1
+            && std::accumulate(squares_of_eight.begin(), squares_of_eight.end(), int64_t{})
+                 == sn2(int64_t{7}) ? "true" : "false" );
+  
+    /* Task 15: the library's own counters; binding "g" over the hundred
+               elements of "ls" and folding the result, once plainly and once
+               under a cancellation token, must add exactly two hundred binds,
+               two hundred units (each allocating its one list node) and two
+               folds of a hundred.
+     */
+    stats_snapshot before = stats::snapshot();
+    foldl(sum, prod(g, ls), int64_t{});
+    foldl(sum, prod(g, ls, cancel_token{}), int64_t{}, cancel_token{});
+    stats_snapshot after = stats::snapshot();
+    printf( "Counted %llu units, %llu binds, %llu maps, %llu folds over %llu elements, %llu allocations\n"
+          , static_cast<unsigned long long>(after[units])
+          , static_cast<unsigned long long>(after[binds])
+          , static_cast<unsigned long long>(after[maps])
+          , static_cast<unsigned long long>(after[folds])
+          , static_cast<unsigned long long>(after[elements])
+          , static_cast<unsigned long long>(after[allocations]) );
+    printf( "Sharded statistics counters add up: %s\n"
+          , after[binds] - before[binds] == 2 * ls.size()
+            && after[units] - before[units] == 2 * ls.size()
+            && after[allocations] - before[allocations] == 2 * ls.size()
+            && after[folds] - before[folds] == 2
+            && after[elements] - before[elements] == 2 * ls.size() ? "true" : "false" );
+  
+    /* Task 16: a fold over a million elements, reduced in chunks on the
+               scheduler, reporting its progress every millisecond at most;
+               in the end a poll must account for every element.
+     */
+    std::list<int64_t> million(1000000);
+    std::iota(million.begin(), million.end(), 0);
+    std::size_t reports = 0;
+    progress watched([&](progress_report const &) { ++reports; }
+                    , std::chrono::milliseconds(1));
+    std::promise<int64_t> reduced;
+    {
+        scheduler workers(2);
+        reduce_async( workers, sum, million, int64_t{}
+                    , [&](int64_t r) { reduced.set_value(r); }
+                    , cancel_token::batch, &watched );
+        reduced.get_future().wait();
+    }
+    progress_report seen = watched.report();
+    printf( "Progress: %zu elements at %.1f M/s in %zu reports\n"
+          , seen.processed, seen.per_second / 1e6, reports );
+    printf( "Progress of the parallel reduction accounted for: %s\n"
+          , seen.processed == million.size() ? "true" : "false" );
+  
+    /* Task 17: grouping 0,1,2,...,99 by their last digit while binding, then
+               folding every group; digit d gathers d, d+10, ..., d+90 whose
+               sum is 10*d + 450, both sequentially and on the scheduler.
+     */
+    auto by_digit = [](int64_t x) {
+        return std::list<std::pair<int64_t, int64_t>>{{x % 10, x}};
+    };
+    auto digits_grouped = [&](keyed<int64_t, int64_t> const & m) {
+        bool ok = m.size() == 10;
+        for(auto & kv : m)
+            ok = ok && kv.second.front() == kv.first
+                    && foldl(sum, kv.second, int64_t{}) == 10 * kv.first + 450;
+        return ok;
+    };
+    std::promise<keyed<int64_t, int64_t>> grouped;
+    {
+        scheduler workers(3);
+        prod_by_key_async( workers, by_digit, ls
+                         , [&](keyed<int64_t, int64_t> m) { grouped.set_value(std::move(m)); }
+                         , 7 );
+    }
+    printf( "Grouped by key while binding, then folded per group: %s\n"
+          , digits_grouped(prod_by_key(by_digit, ls))
+            && digits_grouped(grouped.get_future().get()) ? "true" : "false" );
+  
+    /* Task 18: summing a million elements per residue modulo 7 keeps only
+               seven accumulators around, sequentially or in parallel, and
+               together they add back up to the sum of all of them.
+     */
+    auto by_residue = [](int64_t x) { return x % 7; };
+    auto residues = fold_by_key(make_monoid(sum, int64_t{}), by_residue, million);
+    std::promise<std::unordered_map<int64_t, int64_t>> residues_async;
+    {
+        scheduler workers(3);
+        fold_by_key_async( workers, make_monoid(sum, int64_t{}), by_residue, million
+                         , [&](std::unordered_map<int64_t, int64_t> m) {
+                               residues_async.set_value(std::move(m));
+                           } );
+    }
+    int64_t residue_total = 0;
+    for(auto & kv : residues)
+        residue_total += kv.second;
+    printf( "Folded by key with per-thread pre-aggregation: %s\n"
+          , residues.size() == 7 && residue_total == sn1(int64_t(million.size()) - 1)
+            && residues_async.get_future().get() == residues ? "true" : "false" );
+  
+    /* Task 19: the same square, dot product and sum over a hundred thousand
+               contiguous elements at every instruction set level this CPU
+               runs; all levels must agree with the plain loops.
+     */
+    std::vector<int64_t> wide(100000);
+    std::iota(wide.begin(), wide.end(), 0);
+    auto kernels = [&]() {
+        return std::make_tuple( fmap(sqr, wide)
+                              , foldl(sum, zip_with([](int64_t a, int64_t b) { return a * b; }, wide, wide), int64_t{})
+                              , foldl(sum, wide, int64_t{}) );
+    };
+    simd_force(simd_level::scalar);
+    auto plain = kernels();
+    bool levels_agree = std::get<1>(plain) == sn2(int64_t{99999})
+                     && std::get<2>(plain) == sn1(int64_t{99999});
+    int levels = 1;
+    for(simd_level l : {simd_level::avx2, simd_level::avx512})
+        if(simd_force(l)) {
+            levels_agree = levels_agree && kernels() == plain;
+            ++levels;
+        }
+    simd_force(simd_supported());
+    printf( "Vector kernels agree across %d instruction set level(s): %s\n"
+          , levels, levels_agree ? "true" : "false" );
+  
+    /* Task 20: folds that build containers: a million elements appended to a
+               list that is handed through the folder by value, and spelled
+               into a string by a folder updating it in place. Both are
+               linear, the accumulator is never copied along the way. A
+               folder taking its accumulator by reference and returning the
+               next one is given it as an lvalue.
+     */
+    auto gathered = foldl( [](std::list<int64_t> a, int64_t x) { a.push_back(x); return a; }
+                         , million, std::list<int64_t>{} );
+    auto spelled = foldl( [](std::string & a, int64_t x) { a += char('a' + x % 26); }
+                        , million, std::string{} );
+    auto referenced = foldl([](int64_t & a, int64_t x) { return a + x; }, million, int64_t{});
+    printf( "Folded a million elements into a list and a string: %s\n"
+          , gathered == million && spelled.size() == million.size()
+            && spelled.compare(0, 3, "abc") == 0
+            && referenced == foldl(sum, million, int64_t{}) ? "true" : "false" );
+  
+    /* Task 21: elements nobody is to copy. Move-only pointers go through a bind
+               and a map, then through one more map on the scheduler, and a
+               megabyte string taken in by "unit" comes out of "fmap" in the
+               very buffer it went in with.
+     */
+    std::list<std::unique_ptr<int64_t>> owned;
+    for(int64_t i = 0; i < 1000; ++i)
+        owned.push_back(std::make_unique<int64_t>(i));
+    auto twice_owned = prod( [](std::unique_ptr<int64_t> p) { *p *= 2; return unit(std::move(p)); }
+                           , std::move(owned) );
+    auto kept = fmap([](std::unique_ptr<int64_t> p) { return p; }, std::move(twice_owned));
+    std::promise<std::list<int64_t>> unboxed;
+    {
+        scheduler workers(2);
+        fmap_async( workers, [](std::unique_ptr<int64_t> p) { return *p; }, std::move(kept)
+                  , [&](std::list<int64_t> r) { unboxed.set_value(std::move(r)); } );
+    }
+    auto released = unboxed.get_future().get();
+    std::string payload(1 << 20, 'x');
+    char const * buffer = payload.data();
+    auto carried = fmap([](std::string s) { return s; }, unit(std::move(payload)));
+    printf( "Moved elements through unit, prod and fmap without copies: %s\n"
+          , foldl(sum, released, int64_t{}) == 2 * sn1(int64_t{999})
+            && carried.front().data() == buffer ? "true" : "false" );
+  
+    /* Task 22: binds that end in a fold or a buffer write, without building the
+               list in between: the sum of squares once more, through the
+               usual arrow into a running fold, and the even elements of "ls"
+               emitted by an arrow straight into a vector.
+     */
+    auto squares_sum = prod_into(f, ls, folding(sum, int64_t{})).value;
+    std::vector<int64_t> evens;
+    prod_into( [](int64_t x, auto & emit) { if(x % 2 == 0) emit(x); }
+             , ls, [&](int64_t x) { evens.push_back(x); } );
+    printf( "Bound into a fold and a buffer without intermediate lists: %s\n"
+          , squares_sum == sn2(int64_t(ls.size()) - 1) && evens.size() == ls.size() / 2
+            && foldl(sum, evens, int64_t{}) == 2 * sn1(int64_t(ls.size()) / 2 - 1) ? "true" : "false" );
+  
+#ifdef __SIZEOF_INT128__
+    /* Task 23: "ls" once more, as a formula rather than a list: the sum of
+               squares through a polynomial arrow is a closed form and must
+               agree with folding the list, as must an arrow of too high a
+               degree that has to fall back to the list, or a std::plus too
+               narrow for the elements that has to wrap as the list does. Then
+               sums over ranges no list would fit in: a trillion elements, and
+               the squares of a billion.
+     */
+    typedef __int128 huge;
+    auto square = polynomial<int64_t>{ { 0, 0, 1 } };
+    auto indices = progression<int64_t>::iota(ls.size());
+    auto eighth = fmap(square, fmap(square, fmap(square, indices)));
+    bool closed_forms = !eighth.symbolic && fmap(square, indices).symbolic
+        && foldl(std::plus<int64_t>{}, fmap(square, indices), int64_t{}) == sn2(int64_t(ls.size()) - 1)
+        && foldl(std::plus<int64_t>{}, eighth, int64_t{})
+           == foldl(sum, fmap([](int64_t x) { x *= x; x *= x; return x * x; }, ls), int64_t{})
+        && foldl(std::plus<huge>{}, progression<int64_t>::iota(1000000000000), huge{})
+           == sn1(huge{999999999999})
+        && foldl(std::plus<huge>{}, fmap(square, progression<int64_t>::iota(1000000000)), huge{})
+           == sn2(huge{999999999})
+        && foldl(std::plus<int64_t>{}, fmap(affine<int64_t>(3, -7), indices), int64_t{})
+           == foldl(sum, fmap([](int64_t x) { return 3 * x - 7; }, ls), int64_t{})
+        && foldl(std::plus<uint32_t>{}, progression<int64_t>::iota(4, int64_t{1} << 32), int64_t{})
+           == foldl(std::plus<uint32_t>{}, progression<int64_t>::iota(4, int64_t{1} << 32).materialise(), int64_t{});
+    printf( "Folded symbolic progressions in closed form: %s\n"
+          , closed_forms ? "true" : "false" );
+#endif
+  
+    /* Task 24: the states of a small graph reachable from state 1, where
+               state q leads to 2q and q² + 1 (mod 256): binds over bitsets
+               until nothing new is reached, against a breadth-first search
+               over a std::set.
+     */
+    typedef bitset_set<256> states;
+    std::array<states, 256> successors{};
+    for(std::size_t q = 0; q < 256; ++q) {
+        successors[q].insert(2 * q % 256);
+        successors[q].insert((q * q + 1) % 256);
+    }
+    auto step = [&](std::size_t q) -> states const & { return successors[q]; };
+    states reached = states::unit(1), previous{};
+    while(reached != previous) {
+        previous = reached;
+        reached |= prod(step, reached);
+    }
+    std::set<std::size_t> visited{1};
+    std::vector<std::size_t> queue{1};
+    while(!queue.empty()) {
+        std::size_t q = queue.back();
+        queue.pop_back();
+        for(std::size_t r : { 2 * q % 256, (q * q + 1) % 256 })
+            if(visited.insert(r).second)
+                queue.push_back(r);
+    }
+    printf( "Reached %zu states through bitset binds: %s\n", reached.size()
+          , reached.size() == visited.size()
+            && foldl(std::plus<std::size_t>{}, reached, std::size_t{})
+               == std::accumulate(visited.begin(), visited.end(), std::size_t{})
+            && fmap([](std::size_t q) { return q / 2; }, reached).contains(*visited.rbegin() / 2)
+            ? "true" : "false" );
+  
+    /* Task 25: a checkpointed fold over 0,1,2,...,9999 interrupted part-way
+                must leave its last checkpoint behind and resume from it to the
+                right sum, folding only what was left; a checkpoint left by
+                another fold (another id, another size) must be ignored, and
+                none may remain once a fold completes.
+     */
+    struct interrupted {};
+    std::string const ckpt_path = std::string(std::getenv("TMPDIR") ? std::getenv("TMPDIR") : "/tmp")
+                                + "/monadplay-task25.ckpt";
+    std::list<int64_t> counted(10000);
+    std::iota(counted.begin(), counted.end(), 0);
+    std::list<int64_t> shorter(std::next(counted.begin()), counted.end());
+    std::size_t folded_so_far = 0, stop_at = 0;
+    auto interruptible = [&](int64_t a, int64_t x) {
+        if(++folded_so_far == stop_at)
+            throw interrupted{};
+        return a + x;
+    };
+    auto fold_counted = [&](std::list<int64_t> const & m, uint64_t id, std::size_t stop) {
+        folded_so_far = 0;
+        stop_at = stop;
+        try {
+            return foldl_checkpoint( interruptible, m, int64_t{}, ckpt_path.c_str(), id
+                                   , std::chrono::steady_clock::duration::zero() );
+        } catch(interrupted const &) {
+            return int64_t{-1};
+        }
+    };
+    auto left_behind = [&]() {
+        FILE * fp = fopen(ckpt_path.c_str(), "rb");
+        if(fp)
+            fclose(fp);
+        return fp != nullptr;
+    };
+    bool resumed = fold_counted(counted, 1, 5000) == -1 && left_behind()
+        && fold_counted(counted, 2, 0) == sn1(int64_t{9999})
+        && folded_so_far == counted.size() && !left_behind()
+        && fold_counted(counted, 1, 5000) == -1
+        && fold_counted(shorter, 1, 0) == sn1(int64_t{9999})
+        && folded_so_far == shorter.size() && !left_behind()
+        && fold_counted(counted, 1, 5000) == -1
+        && fold_counted(counted, 1, 0) == sn1(int64_t{9999})
+        && folded_so_far == counted.size() - 4 * checkpoint_batch && !left_behind();
+    std::remove(ckpt_path.c_str());
+    printf( "Resumed an interrupted fold from its checkpoint: %s\n\n"
+          , resumed ? "true" : "false" );
   
     return {};
 }
@@ -0,0 +1,602 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_HPP
+#define MONADPLAY_HPP
+
+#include <list>
+#include <type_traits>
+#include <cstdio>
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iterator>
+#include <cstdint>
+#include <utility>
+#include <cstdlib>
+#include <cerrno>
+#include <mutex>
+#include <vector>
+
+#if defined(__cpp_concepts) && __cpp_concepts >= 201907L
+#include <concepts>
+#define MONADPLAY_REQUIRES(...) requires (__VA_ARGS__)
+#else
+#define MONADPLAY_REQUIRES(...)
+#endif
+
+// The purpose of this code is purely educational, so that the relations between
+// fundamental operations in functional programming constructs become clear to
+// the reader versed in C++; it can be written in many different ways but since
+// I was utterly bored I just picked one at random. This code requires C++14
+// because of std::decay_t, generic lambdas, though can be adapted to C++11
+// but we are already heading towards to C++20, whose concepts are used when
+// the compiler has them. A std::list will be used for
+// the examples and the purpose here is to see how far one can get  with the
+// complexity of the constructs involved as well as whether certain laws are
+// respected. Of course, it is all about the Monads.
+
+// NOTE: Just compile with -std=c++14; everything lives in namespace monadplay
+//       and is header-only. Define MONADPLAY_EXTERN_TEMPLATES and link with
+//       monadplay_inst.cc to reuse its instantiations for int64_t and double
+//       instead of having each translation unit instantiate them again. This
+//       header holds the list monad only; every other instance, and the
+//       scheduler with its threads, lives in a monadplay_*.hpp of its own (add
+//       -pthread for those), so that code binding over lists does not pay for
+//       parsing them.
+
+/*
+ * From Saunders Mac Lane's "Categories for the Working Mathematician", 1971:
+ * 
+ * "All told, a monad in X is just a monoid in the category of endofunctors of
+ *  X, with product × replaced by composition of endofunctors and unit set by
+ *  the identity endofunctor."
+ * 
+ * C++'s design is quite unhelpful in dealing with such constructs but it is
+ * worth a try to understand what Saunders is talking about in coding terms.
+ * 
+ */
+
+namespace monadplay {
+
+/* Step 0: the vocabulary. "hand_over" calls an arrow with an element the
+           caller is done with, moving it in whenever the arrow can take it
+           that way and passing it as an lvalue otherwise, so that heavy and
+           move-only elements go through binds without being copied.
+           "kleisli_t" is what an arrow F gives back for an X handed over so
+           (std::result_of_t is deprecated in C++17 and gone in C++20). Under
+           C++20, "Monad", "KleisliArrow" and "Monoid" constrain the
+           combinators that follow, so a wrong argument is turned away at the
+           call instead of deep inside a pipeline of instantiations; before
+           C++20 MONADPLAY_REQUIRES expands to nothing and they are unchecked.
+           A "Monad" is either list-like (results are spliced together) or one
+           of the later instances spelling "unit" as a static member.
+*/
+template<typename F, typename X>
+auto hand_over(F & f, X & x, int) -> decltype(f(std::move(x))) { return f(std::move(x)); }
+
+template<typename F, typename X>
+auto hand_over(F & f, X & x, long) -> decltype(f(x)) { return f(x); }
+
+template<typename F, typename X>
+auto hand_over(F & f, X & x) -> decltype(hand_over(f, x, 0)) { return hand_over(f, x, 0); }
+
+template<typename F, typename X>
+using kleisli_t = std::decay_t<decltype(hand_over(std::declval<F &>(), std::declval<X &>()))>;
+
+#if defined(__cpp_concepts) && __cpp_concepts >= 201907L
+template<typename M>
+concept Monad = requires { typename M::value_type; }
+    && ( (std::default_initializable<M> && requires(M a, M b) { a.splice(a.end(), b); })
+      || requires(typename M::value_type x) { { M::unit(x) } -> std::same_as<M>; } );
+
+template<typename F, typename X>
+concept KleisliArrow = (std::invocable<F &, X &> || std::invocable<F &, X>)
+    && Monad<kleisli_t<F, X>>;
+
+template<typename F, typename Y, typename X = Y>
+concept Monoid = std::invocable<F &, Y &, X const &>
+    && ( std::is_void_v<std::invoke_result_t<F &, Y &, X const &>>
+      || std::convertible_to<std::invoke_result_t<F &, Y, X const &>, Y>
+      || std::convertible_to<std::invoke_result_t<F &, Y &, X const &>, Y> );
+#endif
+
+/* Counters for the whole library, cheap enough to stay always on: every thread
+   bumps its own cache-line-sized shard with a plain relaxed load and store (no
+   locked instruction, nobody else ever writes there), and a snapshot adds all
+   the shards up, together with what threads that have exited left behind. The
+   registry is only locked when a thread first counts, exits or a snapshot is
+   taken. Build with MONADPLAY_NO_STATS to compile the counting out entirely.
+   Every instance counts alike: "units" per unit made, "binds" per element an
+   arrow is bound to, "maps" per fmap (or zip_with) called, "folds" per fold
+   called and "elements" per element folded; the parallel combinators count
+   one call however many chunks they are cut into. Where a bind only builds a
+   computation (stm, memo, lazy), it is counted each time that computation
+   runs the arrow, not when it is built. "allocations" counts every block the
+   library allocates to hold elements or values (a list node, the buffer of a
+   vector it gives back, a table's node or slots, a segment, a cell); what a
+   std::function, the shared state of a continuation or a growing deque
+   allocates internally is left out.
+*/
+enum stat : std::size_t { units, binds, maps, folds, elements, allocations, stat_count };
+
+struct stats_snapshot {
+    uint64_t count[stat_count];
+    uint64_t operator[](stat k) const { return count[k]; }
+};
+
+class stats {
+public:
+    static void add(stat k, uint64_t n = 1) {
+#ifndef MONADPLAY_NO_STATS
+        std::atomic<uint64_t> & c = local().count[k];
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+#else
+        (void)k, (void)n;
+#endif
+    }
+
+    static stats_snapshot snapshot() {
+        registry & r = reg();
+        std::lock_guard<std::mutex> l(r.m);
+        stats_snapshot t = r.retired;
+        for(shard const * s : r.live)
+            for(std::size_t k = 0; k < stat_count; ++k)
+                t.count[k] += s->count[k].load(std::memory_order_relaxed);
+        return t;
+    }
+
+private:
+    struct alignas(64) shard {
+        std::atomic<uint64_t> count[stat_count];
+    };
+
+    struct registry {
+        std::mutex m;
+        std::vector<shard const *> live;
+        stats_snapshot retired{};
+    };
+
+    struct holder {
+        holder() {
+            for(auto & c : s.count)
+                c.store(0, std::memory_order_relaxed);
+            registry & r = reg();
+            std::lock_guard<std::mutex> l(r.m);
+            r.live.push_back(&s);
+        }
+        ~holder() {
+            registry & r = reg();
+            std::lock_guard<std::mutex> l(r.m);
+            for(std::size_t k = 0; k < stat_count; ++k)
+                r.retired.count[k] += s.count[k].load(std::memory_order_relaxed);
+            r.live.erase(std::find(r.live.begin(), r.live.end(), &s));
+        }
+        shard s;
+    };
+
+    static registry & reg() {
+        static registry r;
+        return r;
+    }
+
+    // The pointer needs no dynamic initialisation, so reaching it on the hot
+    // path costs no guard check; the holder behind it is set up only once.
+    static shard & local() {
+        static thread_local shard * mine = nullptr;
+        if(!mine)
+            mine = &enrol();
+        return *mine;
+    }
+
+    static shard & enrol() {
+        static thread_local holder h;
+        return h.s;
+    }
+};
+
+/* Step 1: define "unit" as *unary* operation for a std::list<X>; it represents
+           the "identity endofunctor", essentially the constructor for a list.
+           An rvalue is moved into the list rather than copied, which also
+           lets move-only elements in.
+*/
+template<typename X> MONADPLAY_REQUIRES(std::copy_constructible<X>)
+std::list<X> unit(X const & x)
+{ stats::add(units); stats::add(allocations); return std::list<X>{x}; }
+
+template<typename X, typename = std::enable_if_t<!std::is_lvalue_reference<X>::value>>
+    MONADPLAY_REQUIRES(std::move_constructible<X>)
+std::list<X> unit(X && x) {
+    stats::add(units);
+    stats::add(allocations);
+    std::list<X> y;
+    y.emplace_back(std::move(x));
+    return y;
+}
+
+/* Step 2: define "prod" operation for a std::list<X>; if empty, returns empty,
+           otherwise the idiomatic way of shifting around items in a list is
+           deployed through a lambda (but could also be without it). Actually,
+           "prod" is the infamous "bind" and beware that unlike "unit", it is
+           a **binary** operation. Notice that "prod" is dedicated to std::list
+           **endofunctor** composition; notice the **recursion** involved.
+           The list is taken by value and every element is handed over to
+           "f", so binding over a list the caller gives up copies nothing.
+*/
+template<typename F, typename X> MONADPLAY_REQUIRES(KleisliArrow<F, X>)
+kleisli_t<F, X> prod(F f, std::list<X> x) {
+    return (x.empty())
+        ? kleisli_t<F, X>{}
+        : [&]() { stats::add(binds);
+                  kleisli_t<F, X> y{ hand_over(f, x.front()) };
+                  x.pop_front();
+                  y.splice(y.end(), prod(f, std::move(x)));
+                  return y;
+                } ();
+}
+
+/* Step 4: "join" (or "flatten") can be defined in terms of prod. */
+template<typename X>
+std::list<X> join(std::list<std::list<X>> x) {
+    return prod([](std::list<X> & y) { return std::move(y); }, std::move(x));
+}
+
+/* Step 5: "fmap" can be defined in terms of prod, unit; what it gives back is
+           a list of whatever "f" maps the elements to.
+*/
+template<typename F, typename X> MONADPLAY_REQUIRES(std::invocable<F &, X &> || std::invocable<F &, X>)
+std::list<kleisli_t<F, X>> fmap(F f, std::list<X> x) {
+    stats::add(maps);
+    return prod([&f](X & y) { return unit(hand_over(f, y)); }, std::move(x));
+}
+
+/* Step 6: "foldl" because it is quite easy to do anyway. Every fold in here
+           takes its step through "fold_step", which moves the accumulator
+           into the folder and back out of it, so that folding into a list or
+           a string does not copy everything gathered so far at every element
+           (quadratic, all told). A folder that cannot take the accumulator
+           as an rvalue (one taking "Y &" and returning the next value) gets
+           it as an lvalue instead, and one returning void is taken to update
+           the accumulator it gets by reference in place.
+*/
+template<typename F, typename Y, typename X>
+using fold_in_place = std::is_void<decltype(std::declval<F &>()(std::declval<Y &>(), std::declval<X const &>()))>;
+
+template<typename F, typename Y, typename X>
+void fold_step(F & f, Y & y, X const & x, std::true_type) { f(y, x); }
+
+template<typename F, typename Y, typename X>
+auto fold_step(F & f, Y & y, X const & x, int) -> decltype(void(y = f(std::move(y), x))) { y = f(std::move(y), x); }
+
+template<typename F, typename Y, typename X>
+auto fold_step(F & f, Y & y, X const & x, long) -> decltype(void(y = f(y, x))) { y = f(y, x); }
+
+template<typename F, typename Y, typename X>
+void fold_step(F & f, Y & y, X const & x, std::false_type) { fold_step(f, y, x, 0); }
+
+template<typename F, typename Y, typename X>
+void fold_step(F & f, Y & y, X const & x) { fold_step(f, y, x, fold_in_place<F, Y, X>{}); }
+
+template<typename F, typename X, typename Y> MONADPLAY_REQUIRES(Monoid<F, Y, X>)
+Y foldl(F f, std::list<X> const & m, Y y) {
+    stats::add(folds);
+    stats::add(elements, m.size());
+    for(auto && i : m)
+        fold_step(f, y, i);
+    return y;
+}
+
+/* Step 7: "foldl" once more, for folds that run long enough to be worth
+           resuming after a crash: at most every "interval" the position
+           reached and the accumulator so far are written to "path", first to
+           a temporary file that is then renamed over it so that a crash while
+           writing can never leave a torn checkpoint behind. The clock is only
+           looked at every "checkpoint_batch" elements, so however cheap the
+           steps, the overhead stays that of one clock read per batch plus one
+           write per "interval" (an interval of zero writes at every batch).
+           The file starts with a header carrying a magic number, sizeof(Y),
+           "id" (anything the caller picks to tell its folds apart) and the
+           size of the list; folding resumes from it only if all of these
+           match, and starts afresh otherwise. Once the fold completes the
+           checkpoint is removed. A checkpoint that cannot be written does not
+           stop the fold, but the errno of the last such failure is left in
+           "*error" (zero if there was none).
+*/
+enum : std::size_t { checkpoint_batch = 1024 };
+
+struct checkpoint_header {
+    uint64_t magic;
+    uint64_t accumulator_size;
+    uint64_t id;
+    uint64_t size;
+    uint64_t position;
+
+    static constexpr uint64_t expected = 0x6d6f6e6164636b31; // "monadck1"
+};
+
+template<typename Y>
+struct checkpoint {
+    checkpoint_header header;
+    Y accumulator;
+};
+
+template<typename Y>
+bool load_checkpoint(char const * path, checkpoint<Y> & c) {
+    FILE * fp = fopen(path, "rb");
+    if(!fp)
+        return false;
+    checkpoint<Y> r;
+    bool ok = fread(&r.header, sizeof(r.header), 1, fp) == 1
+           && r.header.magic == checkpoint_header::expected
+           && r.header.accumulator_size == sizeof(Y)
+           && r.header.id == c.header.id
+           && r.header.size == c.header.size
+           && r.header.position <= r.header.size
+           && fread(&r.accumulator, sizeof(Y), 1, fp) == 1;
+    fclose(fp);
+    if(ok)
+        c = r;
+    return ok;
+}
+
+template<typename Y>
+bool save_checkpoint(char const * path, checkpoint<Y> const & c) {
+    std::string tmp = std::string(path) + ".tmp";
+    FILE * fp = fopen(tmp.c_str(), "wb");
+    if(!fp)
+        return false;
+    bool ok = fwrite(&c.header, sizeof(c.header), 1, fp) == 1
+           && fwrite(&c.accumulator, sizeof(Y), 1, fp) == 1;
+    ok = fclose(fp) == 0 && ok;
+    return ok && std::rename(tmp.c_str(), path) == 0;
+}
+
+template<typename F, typename X, typename Y> MONADPLAY_REQUIRES(Monoid<F, Y, X>)
+Y foldl_checkpoint( F f, std::list<X> const & m, Y y, char const * path, uint64_t id
+                  , std::chrono::steady_clock::duration interval = std::chrono::seconds(1)
+                  , int * error = nullptr ) {
+    static_assert( std::is_trivially_copyable<Y>::value
+                 , "checkpointed accumulators must be trivially copyable" );
+    typedef std::chrono::steady_clock clock;
+    if(error)
+        *error = 0;
+    checkpoint<Y> c{ { checkpoint_header::expected, sizeof(Y), id, m.size(), 0 }, y };
+    load_checkpoint(path, c);
+    auto due = clock::now() + interval;
+    for(auto i = std::next(m.begin(), c.header.position); i != m.end(); ++i) {
+        fold_step(f, c.accumulator, *i);
+        if(++c.header.position % checkpoint_batch == 0 && clock::now() >= due) {
+            errno = 0;
+            if(!save_checkpoint(path, c) && error)
+                *error = errno ? errno : EIO;
+            due = clock::now() + interval;
+        }
+    }
+    std::remove(path);
+    return c.accumulator;
+}
+
+/* Step 8: a runaway bind (think of an exponential nondeterministic search)
+           cannot be stopped once "prod" has started, so "prod", "fmap" and
+           "foldl" get variants that look at a cancellation token every
+           "batch" elements and stop early, returning whatever was computed so
+           far; the token itself tells the caller whether that result is
+           partial. A token is cancelled explicitly or once its deadline has
+           passed, the clock being read only at batch boundaries. Arrows doing
+           binds of their own should pass the very same token along.
+*/
+class cancel_token {
+public:
+    typedef std::chrono::steady_clock clock;
+    static constexpr std::size_t batch = 1024;
+
+    cancel_token() : deadline(clock::time_point::max()) {}
+    explicit cancel_token(clock::duration d) : deadline(clock::now() + d) {}
+
+    void cancel() { flag.store(true, std::memory_order_relaxed); }
+
+    bool cancelled() const {
+        if(flag.load(std::memory_order_relaxed))
+            return true;
+        if(deadline == clock::time_point::max() || clock::now() < deadline)
+            return false;
+        flag.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    mutable std::atomic<bool> flag{false};
+    clock::time_point deadline;
+};
+
+template<typename F, typename X> MONADPLAY_REQUIRES(KleisliArrow<F, X>)
+kleisli_t<F, X> prod(F f, std::list<X> x, cancel_token const & c) {
+    kleisli_t<F, X> y;
+    std::size_t n = 0;
+    for(auto && i : x) {
+        if(n % cancel_token::batch == 0 && c.cancelled())
+            break;
+        y.splice(y.end(), hand_over(f, i));
+        ++n;
+    }
+    stats::add(binds, n);
+    return y;
+}
+
+template<typename F, typename X> MONADPLAY_REQUIRES(std::invocable<F &, X &> || std::invocable<F &, X>)
+std::list<kleisli_t<F, X>> fmap(F f, std::list<X> x, cancel_token const & c) {
+    stats::add(maps);
+    return prod([&f](X & y) { return unit(hand_over(f, y)); }, std::move(x), c);
+}
+
+template<typename F, typename X, typename Y> MONADPLAY_REQUIRES(Monoid<F, Y, X>)
+Y foldl(F f, std::list<X> const & m, Y y, cancel_token const & c) {
+    std::size_t n = 0;
+    for(auto && i : m) {
+        if(n % cancel_token::batch == 0 && c.cancelled())
+            break;
+        fold_step(f, y, i);
+        ++n;
+    }
+    stats::add(folds);
+    stats::add(elements, n);
+    return y;
+}
+
+/* Progress is looked at on the same batch boundaries as cancellation: a long
+   "foldl" or "prod", or a parallel reducer, reports how many elements it has
+   gone through to a "progress", which passes the count, the time elapsed and
+   the throughput on to its callback no more often than every "interval" (when
+   several threads report, one past the interval calls it while the others go
+   on with their work, so calls never overlap), and can also be polled from
+   any thread with "report".
+*/
+struct progress_report {
+    std::size_t processed;
+    double seconds;
+    double per_second;
+};
+
+class progress {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    explicit progress( std::function<void(progress_report const &)> callback
+                     , clock::duration interval = std::chrono::seconds(1) )
+        : callback(std::move(callback)), interval(interval), start(clock::now())
+        , due((start + interval).time_since_epoch().count()) {}
+
+    void advance(std::size_t n) {
+        count.fetch_add(n, std::memory_order_relaxed);
+        clock::rep now = clock::now().time_since_epoch().count();
+        if(now < due.load(std::memory_order_relaxed))
+            return;
+        std::unique_lock<std::mutex> l(calling, std::try_to_lock);
+        if(!l.owns_lock() || now < due.load(std::memory_order_relaxed))
+            return;
+        due.store(now + interval.count(), std::memory_order_relaxed);
+        if(callback)
+            callback(report());
+    }
+
+    progress_report report() const {
+        std::size_t n = count.load(std::memory_order_relaxed);
+        double t = std::chrono::duration<double>(clock::now() - start).count();
+        return { n, t, t > 0 ? n / t : 0.0 };
+    }
+
+private:
+    std::function<void(progress_report const &)> callback;
+    clock::duration const interval;
+    clock::time_point const start;
+    std::atomic<std::size_t> count{0};
+    std::atomic<clock::rep> due;
+    std::mutex calling;
+};
+
+template<typename F, typename X> MONADPLAY_REQUIRES(KleisliArrow<F, X>)
+kleisli_t<F, X> prod(F f, std::list<X> x, progress & p) {
+    kleisli_t<F, X> y;
+    std::size_t n = 0;
+    for(auto && i : x) {
+        y.splice(y.end(), hand_over(f, i));
+        if(++n == cancel_token::batch) {
+            p.advance(n);
+            n = 0;
+        }
+    }
+    p.advance(n);
+    stats::add(binds, x.size());
+    return y;
+}
+
+template<typename F, typename X, typename Y> MONADPLAY_REQUIRES(Monoid<F, Y, X>)
+Y foldl(F f, std::list<X> const & m, Y y, progress & p) {
+    std::size_t n = 0;
+    for(auto && i : m) {
+        fold_step(f, y, i);
+        if(++n == cancel_token::batch) {
+            p.advance(n);
+            n = 0;
+        }
+    }
+    p.advance(n);
+    stats::add(folds);
+    stats::add(elements, m.size());
+    return y;
+}
+
+/* Step 23: most binds end in a fold or a write, and then the list "prod"
+            builds is only there to be taken apart again. "prod_into" hands
+            every element the arrow produces to a "sink" instead, any callable
+            taking one element (the running fold below, a push into a buffer
+            or a channel), and gives the sink back when done, the way
+            std::for_each gives back its function. An arrow may also take the
+            sink as a second argument and emit into it directly, so that no
+            intermediate list is built at all; arrows that do not are bound as
+            usual and their results moved into the sink one by one.
+*/
+template<typename F, typename Y>
+struct folding_sink {
+    F f;
+    Y value;
+
+    template<typename X>
+    void operator()(X const & x) { fold_step(f, value, x); }
+};
+
+template<typename F, typename Y>
+folding_sink<F, Y> folding(F f, Y y) { return { std::move(f), std::move(y) }; }
+
+template<typename F, typename X, typename S>
+auto emit_into(F & f, X & x, S & sink, int) -> decltype(void(f(std::move(x), sink)))
+{ f(std::move(x), sink); }
+
+template<typename F, typename X, typename S>
+auto emit_into(F & f, X & x, S & sink, long) -> decltype(void(f(x, sink)))
+{ f(x, sink); }
+
+template<typename F, typename X, typename S>
+void emit_into(F & f, X & x, S & sink, ...) {
+    for(auto & y : hand_over(f, x))
+        sink(std::move(y));
+}
+
+template<typename F, typename X, typename S>
+S prod_into(F f, std::list<X> x, S sink) {
+    stats::add(binds, x.size());
+    for(auto & i : x)
+        emit_into(f, i, sink, 0);
+    return sink;
+}
+
+// std::hash is often the identity on integers; spread its bits before using
+// them to pick a slot or a partition (the finaliser of MurmurHash3).
+inline uint64_t mix_bits(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+#ifdef MONADPLAY_EXTERN_TEMPLATES
+extern template std::list<int64_t> unit(int64_t const &);
+extern template std::list<double> unit(double const &);
+extern template std::list<int64_t> unit(int64_t &&);
+extern template std::list<double> unit(double &&);
+extern template std::list<int64_t> join(std::list<std::list<int64_t>>);
+extern template std::list<double> join(std::list<std::list<double>>);
+extern template int64_t
+    foldl(std::plus<int64_t>, std::list<int64_t> const &, int64_t);
+extern template double
+    foldl(std::plus<double>, std::list<double> const &, double);
+#endif
+
+} // namespace monadplay
+
+#endif // MONADPLAY_HPP
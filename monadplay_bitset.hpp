@@ -0,0 +1,137 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_BITSET_HPP
+#define MONADPLAY_BITSET_HPP
+
+#include "monadplay_simd.hpp"
+
+#include <array>
+#include <cassert>
+
+// monadplay: the set monad over small integer domains as bitsets.
+
+namespace monadplay {
+
+/* Step 25: nondeterminism over a small domain of states [0, N), the way an
+            automaton or a search over a small graph goes, without the hashing
+            of a general set: a bitset_set<N> is N bits in 64-bit words. "prod"
+            ORs together the successor sets of the states present through the
+            "zip_with" kernels of Step 22 (monadplay_simd.hpp), as wide as the CPU allows, and arrows
+            that look their successors up in a table can return them by
+            reference so that nothing is copied. "foldl" and "fmap" visit the
+            states present by counting trailing zeros of each word and then
+            clearing the lowest bit, so a sparse set costs what it holds and
+            not N. States are checked against N by assert only, as indices
+            into a std::array would be.
+*/
+inline unsigned lowest_bit(std::uint64_t w) {
+#if defined(__GNUC__) || defined(__clang__)
+    return unsigned(__builtin_ctzll(w));
+#else
+    unsigned n = 0;
+    for(; !(w & 1); w >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+inline void or_words(std::uint64_t * x, std::uint64_t const * y, std::size_t n) {
+    std::bit_or<std::uint64_t> f;
+    switch(simd_active().load(std::memory_order_relaxed)) {
+#ifdef MONADPLAY_SIMD_X86
+    case simd_level::avx512: zip_avx512(f, x, y, x, n); break;
+    case simd_level::avx2:   zip_avx2(f, x, y, x, n); break;
+#endif
+    default:                 zip_loop(f, x, y, x, n); break;
+    }
+}
+
+inline unsigned count_bits(std::uint64_t w) {
+#if defined(__GNUC__) || defined(__clang__)
+    return unsigned(__builtin_popcountll(w));
+#else
+    unsigned n = 0;
+    for(; w; w &= w - 1)
+        ++n;
+    return n;
+#endif
+}
+
+template<std::size_t N>
+struct bitset_set {
+    typedef std::size_t value_type;
+    enum : std::size_t { words = (N + 63) / 64 };
+
+    std::array<std::uint64_t, words> bits{};
+
+    static bitset_set unit(std::size_t x) {
+        bitset_set s{};
+        s.insert(x);
+        return s;
+    }
+
+    void insert(std::size_t x) {
+        assert(x < N && "state out of the domain of the bitset_set");
+        bits[x / 64] |= std::uint64_t{1} << x % 64;
+    }
+
+    bool contains(std::size_t x) const { return x < N && (bits[x / 64] >> x % 64 & 1); }
+
+    bool empty() const {
+        for(auto w : bits)
+            if(w)
+                return false;
+        return true;
+    }
+
+    std::size_t size() const {
+        std::size_t n = 0;
+        for(auto w : bits)
+            n += count_bits(w);
+        return n;
+    }
+
+    bitset_set & operator|=(bitset_set const & o) {
+        or_words(bits.data(), o.bits.data(), words);
+        return *this;
+    }
+
+    friend bool operator==(bitset_set const & a, bitset_set const & b) { return a.bits == b.bits; }
+    friend bool operator!=(bitset_set const & a, bitset_set const & b) { return a.bits != b.bits; }
+
+    template<typename G>
+    void for_each(G g) const {
+        for(std::size_t i = 0; i < words; ++i)
+            for(std::uint64_t w = bits[i]; w; w &= w - 1)
+                g(i * 64 + lowest_bit(w));
+    }
+};
+
+template<typename F, std::size_t N> MONADPLAY_REQUIRES(KleisliArrow<F, std::size_t>)
+kleisli_t<F, std::size_t> prod(F f, bitset_set<N> const & m) {
+    stats::add(binds, m.size());
+    kleisli_t<F, std::size_t> y{};
+    m.for_each([&](std::size_t i) { y |= f(i); });
+    return y;
+}
+
+template<typename F, std::size_t N> MONADPLAY_REQUIRES(std::invocable<F &, std::size_t>)
+bitset_set<N> fmap(F f, bitset_set<N> const & m) {
+    stats::add(maps);
+    bitset_set<N> y{};
+    m.for_each([&](std::size_t i) { y.insert(f(i)); });
+    return y;
+}
+
+template<typename F, typename Y, std::size_t N> MONADPLAY_REQUIRES(Monoid<F, Y, std::size_t>)
+Y foldl(F f, bitset_set<N> const & m, Y y) {
+    stats::add(folds);
+    stats::add(elements, m.size());
+    m.for_each([&](std::size_t i) { fold_step(f, y, i); });
+    return y;
+}
+
+} // namespace monadplay
+
+#endif // MONADPLAY_BITSET_HPP
@@ -0,0 +1,210 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_BY_KEY_HPP
+#define MONADPLAY_BY_KEY_HPP
+
+#include "monadplay_scheduler.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// monadplay: binds and folds grouped by key, sequential and on the scheduler.
+
+namespace monadplay {
+
+/* Step 20: arrows producing (key, value) pairs that are then aggregated per key.
+            "prod_by_key" binds such an arrow and drops every value into its
+            key's list as it is produced, so the result is already grouped and
+            each group can be folded without another pass over the pairs.
+            "prod_by_key_async" does so in parallel: each chunk's task scatters
+            its pairs into one buffer per hash partition of the key space (as
+            many as there are workers), after which one task per partition
+            gathers that partition from every chunk; values keep the order of
+            the elements that produced them.
+*/
+template<typename K, typename V>
+using keyed = std::unordered_map<K, std::list<V>>;
+
+template<typename F, typename X>
+using keyed_t = keyed< typename kleisli_t<F, X>::value_type::first_type
+                     , typename kleisli_t<F, X>::value_type::second_type >;
+
+template<typename F, typename X> MONADPLAY_REQUIRES(KleisliArrow<F, X const>)
+keyed_t<F, X const> prod_by_key(F f, std::list<X> const & x) {
+    keyed_t<F, X const> y;
+    std::size_t n = 0;
+    for(auto & i : x)
+        for(auto & kv : f(i)) {
+            y[kv.first].push_back(std::move(kv.second));
+            ++n;
+        }
+    stats::add(binds, x.size());
+    stats::add(allocations, n + y.size());
+    return y;
+}
+
+template<typename F, typename X, typename K> MONADPLAY_REQUIRES(KleisliArrow<F, X>)
+void prod_by_key_async( scheduler & s, F f, std::list<X> x, K k
+                      , std::size_t grain = cancel_token::batch ) {
+    typedef keyed_t<F, X> M;
+    typedef typename M::key_type Key;
+    struct state {
+        state(std::vector<std::list<X>> v, std::size_t p, K k)
+            : in(std::move(v)), parts(in.size(), std::vector<M>(p)), out(p)
+            , chunks_left(in.size()), parts_left(p), k(std::move(k)) {}
+
+        std::vector<std::list<X>> in;
+        std::vector<std::vector<M>> parts;
+        std::vector<M> out;
+        std::atomic<std::size_t> chunks_left, parts_left;
+        K k;
+    };
+    auto v = chunks(std::move(x), grain);
+    if(v.empty())
+        return s.spawn([k]() mutable { k(M{}); });
+    auto st = std::make_shared<state>(std::move(v), s.size(), std::move(k));
+    auto gather = [st](std::size_t p) {
+        for(auto & c : st->parts)
+            for(auto & kv : c[p]) {
+                auto & l = st->out[p][kv.first];
+                l.splice(l.end(), kv.second);
+            }
+        stats::add(allocations, st->out[p].size());
+        if(st->parts_left.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        M y(std::make_move_iterator(st->out[0].begin()), std::make_move_iterator(st->out[0].end()));
+        for(std::size_t q = 1; q < st->out.size(); ++q)
+            y.insert( std::make_move_iterator(st->out[q].begin())
+                    , std::make_move_iterator(st->out[q].end()) );
+        stats::add(allocations, y.size());
+        st->k(std::move(y));
+    };
+    for(std::size_t i = 0; i < st->in.size(); ++i)
+        s.spawn([&s, st, f, i, gather]() mutable {
+            std::vector<M> & mine = st->parts[i];
+            std::size_t n = 0;
+            for(auto & e : st->in[i])
+                for(auto & kv : f(e)) {
+                    mine[mix_bits(std::hash<Key>{}(kv.first)) % mine.size()][kv.first]
+                        .push_back(std::move(kv.second));
+                    ++n;
+                }
+            for(auto & part : mine)
+                n += part.size();
+            stats::add(binds, st->in[i].size());
+            stats::add(allocations, n);
+            if(st->chunks_left.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            for(std::size_t p = 0; p < st->out.size(); ++p)
+                s.spawn([gather, p]() { gather(p); });
+        });
+}
+
+/* Step 21: aggregating per key without materialising the pairs at all. A
+            monoid is an associative "op" together with its "identity", and
+            "fold_by_key" folds every element into the accumulator of the key
+            "keyfn" gives it, so memory grows with the number of distinct keys
+            rather than the number of elements. "fold_by_key_async" does the
+            same in parallel: each task pre-aggregates its chunk into tables of
+            its own, one per hash partition of the keys, and then one task per
+            partition merges that partition of every table with "op" itself.
+            By default there are as many chunks as workers, so there are as
+            many tables per partition as there are threads; "op" has to accept
+            both (accumulator, element) and (accumulator, accumulator). A key
+            already in a table is looked up before anything is emplaced, so
+            only a key seen for the first time costs an allocation.
+*/
+template<typename F, typename Y>
+struct monoid {
+    F op;
+    Y identity;
+};
+
+template<typename F, typename Y>
+monoid<F, Y> make_monoid(F op, Y identity) { return { op, identity }; }
+
+template<typename M, typename Key, typename Y>
+Y & accumulator_of(M & y, Key && key, Y const & identity) {
+    auto at = y.find(key);
+    if(at == y.end()) {
+        at = y.emplace(std::forward<Key>(key), identity).first;
+        stats::add(allocations);
+    }
+    return at->second;
+}
+
+template<typename Y, typename G, typename X>
+using folded_by_key_t = std::unordered_map<std::decay_t<decltype(std::declval<G &>()(std::declval<X &>()))>, Y>;
+
+template<typename F, typename Y, typename G, typename X> MONADPLAY_REQUIRES(Monoid<F, Y, X>)
+folded_by_key_t<Y, G, X> fold_by_key(monoid<F, Y> m, G keyfn, std::list<X> const & x) {
+    folded_by_key_t<Y, G, X> y;
+    for(auto & i : x) {
+        fold_step(m.op, accumulator_of(y, keyfn(i), m.identity), i);
+    }
+    stats::add(folds);
+    stats::add(elements, x.size());
+    return y;
+}
+
+template<typename F, typename Y, typename G, typename X, typename K>
+    MONADPLAY_REQUIRES(Monoid<F, Y, X> && Monoid<F, Y>)
+void fold_by_key_async( scheduler & s, monoid<F, Y> m, G keyfn, std::list<X> x, K k
+                      , std::size_t grain = 0 ) {
+    typedef folded_by_key_t<Y, G, X> M;
+    typedef typename M::key_type Key;
+    struct state {
+        state(std::vector<std::list<X>> v, std::size_t p, K k)
+            : in(std::move(v)), parts(in.size(), std::vector<M>(p)), out(p)
+            , chunks_left(in.size()), parts_left(p), k(std::move(k)) {}
+
+        std::vector<std::list<X>> in;
+        std::vector<std::vector<M>> parts;
+        std::vector<M> out;
+        std::atomic<std::size_t> chunks_left, parts_left;
+        K k;
+    };
+    stats::add(folds);
+    if(grain == 0)
+        grain = std::max<std::size_t>(1, (x.size() + s.size() - 1) / s.size());
+    auto v = chunks(std::move(x), grain);
+    if(v.empty())
+        return s.spawn([k]() mutable { k(M{}); });
+    auto st = std::make_shared<state>(std::move(v), s.size(), std::move(k));
+    auto merge = [st, m](std::size_t p) mutable {
+        for(auto & c : st->parts)
+            for(auto & kv : c[p]) {
+                fold_step(m.op, accumulator_of(st->out[p], kv.first, m.identity), kv.second);
+            }
+        if(st->parts_left.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        M y(std::make_move_iterator(st->out[0].begin()), std::make_move_iterator(st->out[0].end()));
+        for(std::size_t q = 1; q < st->out.size(); ++q)
+            y.insert( std::make_move_iterator(st->out[q].begin())
+                    , std::make_move_iterator(st->out[q].end()) );
+        stats::add(allocations, y.size());
+        st->k(std::move(y));
+    };
+    for(std::size_t i = 0; i < st->in.size(); ++i)
+        s.spawn([&s, st, m, keyfn, i, merge]() mutable {
+            std::vector<M> & mine = st->parts[i];
+            for(auto & e : st->in[i]) {
+                Key key = keyfn(e);
+                M & part = mine[mix_bits(std::hash<Key>{}(key)) % mine.size()];
+                fold_step(m.op, accumulator_of(part, std::move(key), m.identity), e);
+            }
+            stats::add(elements, st->in[i].size());
+            if(st->chunks_left.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            for(std::size_t p = 0; p < st->out.size(); ++p)
+                s.spawn([merge, p]() mutable { merge(p); });
+        });
+}
+
+} // namespace monadplay
+
+#endif // MONADPLAY_BY_KEY_HPP
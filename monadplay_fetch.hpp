@@ -0,0 +1,133 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_FETCH_HPP
+#define MONADPLAY_FETCH_HPP
+
+#include "monadplay.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+// monadplay: batched lookups through a data source.
+
+namespace monadplay {
+
+/* Step 15: arrows looking records up by key would issue a request per element
+            of "prod". A fetch<X> is instead either done, holding its X, or
+            blocked on keys asked of some data_source, holding what to run
+            once they have arrived. Binding a blocked fetch stays blocked, and
+            "fetch_all" runs an arrow over a list collecting the keys all the
+            elements are blocked on, so that "run_fetch" can hand them to each
+            source as a single deduplicated batch per round. A source keeps
+            what it fetched for as long as it lives, typically one run.
+*/
+template<typename K, typename V>
+class data_source {
+public:
+    typedef std::function<std::map<K, V>(std::vector<K> const &)> backend;
+
+    explicit data_source(backend b) : get(std::move(b)) {}
+
+    V const * cached(K const & k) const {
+        auto i = cache.find(k);
+        return i == cache.end() ? nullptr : &i->second;
+    }
+
+    void want(K const & k) { wanted.insert(k); }
+
+    V const & at(K const & k) const { return cache.at(k); }
+
+    void flush() {
+        if(wanted.empty())
+            return;
+        for(auto & kv : get(std::vector<K>(wanted.begin(), wanted.end())))
+            cache.insert(kv);
+        wanted.clear();
+        ++batches;
+    }
+
+    std::size_t batches = 0;
+
+private:
+    backend get;
+    std::map<K, V> cache;
+    std::set<K> wanted;
+};
+
+template<typename X>
+struct fetch {
+    typedef X value_type;
+
+    std::shared_ptr<X> value;
+    std::function<fetch()> more;
+
+    bool done() const { return value != nullptr; }
+
+    static fetch unit(X x) {
+        stats::add(allocations);
+        return { std::make_shared<X>(std::move(x)), {} };
+    }
+};
+
+template<typename K, typename V>
+fetch<V> lookup(data_source<K, V> & s, K const & k) {
+    if(V const * v = s.cached(k))
+        return fetch<V>::unit(*v);
+    s.want(k);
+    return { nullptr, [&s, k]() { return fetch<V>::unit(s.at(k)); } };
+}
+
+template<typename F, typename X> MONADPLAY_REQUIRES(KleisliArrow<F, X>)
+kleisli_t<F, X> prod(F f, fetch<X> m) {
+    if(m.done()) {
+        stats::add(binds);
+        return f(*m.value);
+    }
+    return { nullptr, [=]() mutable { return prod(f, m.more()); } };
+}
+
+template<typename X>
+fetch<std::list<X>> collect(std::vector<fetch<X>> v) {
+    if(std::all_of(v.begin(), v.end(), [](fetch<X> const & m) { return m.done(); })) {
+        std::list<X> y;
+        for(auto & m : v)
+            y.push_back(*m.value);
+        stats::add(allocations, v.size());
+        return fetch<std::list<X>>::unit(std::move(y));
+    }
+    return { nullptr, [v]() mutable {
+        for(auto & m : v)
+            if(!m.done())
+                m = m.more();
+        return collect(std::move(v));
+    } };
+}
+
+template<typename F, typename X> MONADPLAY_REQUIRES(std::invocable<F &, X const &>)
+fetch<std::list<typename kleisli_t<F, X const>::value_type>>
+fetch_all(F f, std::list<X> const & x) {
+    std::vector<kleisli_t<F, X const>> v;
+    v.reserve(x.size());
+    for(auto & i : x)
+        v.push_back(f(i));
+    return collect(std::move(v));
+}
+
+template<typename X, typename... S>
+X run_fetch(fetch<X> m, S &... sources) {
+    while(!m.done()) {
+        (void)std::initializer_list<int>{ (sources.flush(), 0)... };
+        m = m.more();
+    }
+    return *m.value;
+}
+
+} // namespace monadplay
+
+#endif // MONADPLAY_FETCH_HPP
@@ -0,0 +1,21 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#include "monadplay.hpp"
+
+// Explicit instantiations of the combinators for the element types used most;
+// translation units built with MONADPLAY_EXTERN_TEMPLATES link against these
+// rather than instantiating their own copies.
+
+namespace monadplay {
+
+template std::list<int64_t> unit(int64_t const &);
+template std::list<double> unit(double const &);
+template std::list<int64_t> unit(int64_t &&);
+template std::list<double> unit(double &&);
+template std::list<int64_t> join(std::list<std::list<int64_t>>);
+template std::list<double> join(std::list<std::list<double>>);
+template int64_t foldl(std::plus<int64_t>, std::list<int64_t> const &, int64_t);
+template double foldl(std::plus<double>, std::list<double> const &, double);
+
+} // namespace monadplay
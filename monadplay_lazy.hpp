@@ -0,0 +1,91 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_LAZY_HPP
+#define MONADPLAY_LAZY_HPP
+
+#include "monadplay.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// monadplay: call-by-need cells.
+
+namespace monadplay {
+
+/* Step 16: call-by-need. A lazy<X> is a shared cell holding either an X or the
+            thunk that computes it; forcing it runs the thunk at most once, no
+            matter how many copies of the cell or threads force it, and keeps
+            the result for everyone after. "unit" makes a cell that is already
+            evaluated while "prod" and "fmap" make deferred ones, so a shared
+            sub-pipeline costs nothing until needed and is computed only once.
+*/
+template<typename X>
+class lazy {
+public:
+    typedef X value_type;
+
+    explicit lazy(std::function<X()> f) : cell(std::make_shared<state>()) {
+        stats::add(allocations);
+        cell->thunk = std::move(f);
+    }
+
+    static lazy unit(X x) {
+        lazy l;
+        l.cell->value.reset(new X(std::move(x)));
+        stats::add(allocations);
+        l.cell->ready.store(true, std::memory_order_release);
+        return l;
+    }
+
+    X const & force() const {
+        if(!cell->ready.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> l(cell->m);
+            if(!cell->ready.load(std::memory_order_relaxed)) {
+                cell->value.reset(new X(cell->thunk()));
+                stats::add(allocations);
+                cell->thunk = nullptr;
+                cell->ready.store(true, std::memory_order_release);
+            }
+        }
+        return *cell->value;
+    }
+
+private:
+    struct state {
+        std::atomic<bool> ready{false};
+        std::mutex m;
+        std::function<X()> thunk;
+        std::unique_ptr<X> value;
+    };
+
+    lazy() : cell(std::make_shared<state>()) { stats::add(allocations); }
+
+    std::shared_ptr<state> cell;
+};
+
+template<typename X>
+X const & force(lazy<X> const & m) { return m.force(); }
+
+template<typename F, typename X> MONADPLAY_REQUIRES(KleisliArrow<F, X>)
+kleisli_t<F, X> prod(F f, lazy<X> m) {
+    typedef typename kleisli_t<F, X>::value_type Y;
+    return kleisli_t<F, X>([=]() mutable -> Y {
+        X x = force(m);
+        stats::add(binds);
+        return force(hand_over(f, x));
+    });
+}
+
+template<typename F, typename X> MONADPLAY_REQUIRES(std::invocable<F &, X &> || std::invocable<F &, X>)
+auto fmap(F f, lazy<X> m) {
+    typedef kleisli_t<F, X> Y;
+    stats::add(maps);
+    return lazy<Y>([=]() mutable -> Y { X x = force(m); return hand_over(f, x); });
+}
+
+} // namespace monadplay
+
+#endif // MONADPLAY_LAZY_HPP
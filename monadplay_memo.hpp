@@ -0,0 +1,137 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_MEMO_HPP
+#define MONADPLAY_MEMO_HPP
+
+#include "monadplay.hpp"
+
+#include <functional>
+#include <vector>
+
+// monadplay: memoised recursive binds over a bounded table.
+
+namespace monadplay {
+
+/* Step 17: recursive binds over overlapping subproblems (partition counts, edit
+            distances) recompute them exponentially often. A memo<K, V, X> is
+            a computation of an X threading a memo_table from K to V, the way
+            a State would; "memo_fix" ties the knot of a recursive arrow K ->
+            memo<K, V> that consults the table before computing and fills it
+            after, so that every subproblem is solved once. The table is a
+            flat open-addressing one (linear probing over a power of two of
+            slots); given a bound it never grows past it and a key that cannot
+            find a free slot within a few probes evicts the last one probed.
+*/
+
+template<typename K, typename V>
+class memo_table {
+public:
+    explicit memo_table(std::size_t bound = 0)
+        : bound(bound), slots(bound ? ceil2(bound) : 16) { stats::add(allocations); }
+
+    V const * find(K const & k) const {
+        for(std::size_t i = home(k), n = 0; n < reach(); ++n, ++i) {
+            slot const & s = slots[i & (slots.size() - 1)];
+            if(!s.used)
+                return nullptr;
+            if(s.key == k)
+                return &s.value;
+        }
+        return nullptr;
+    }
+
+    void insert(K const & k, V v) {
+        if(!bound && 2 * (count + 1) > slots.size())
+            grow();
+        std::size_t i = home(k);
+        for(std::size_t n = 1; n < reach(); ++n, ++i) {
+            slot const & s = slots[i & (slots.size() - 1)];
+            if(!s.used || s.key == k)
+                break;
+        }
+        slot & s = slots[i & (slots.size() - 1)];
+        count += !s.used;
+        s = slot{true, k, std::move(v)};
+    }
+
+private:
+    struct slot {
+        bool used;
+        K key;
+        V value;
+    };
+
+    static constexpr std::size_t probes = 8;
+
+    static std::size_t ceil2(std::size_t n) {
+        std::size_t c = 1;
+        while(c < n)
+            c <<= 1;
+        return c;
+    }
+
+    std::size_t home(K const & k) const {
+        return static_cast<std::size_t>(mix_bits(std::hash<K>{}(k)));
+    }
+
+    std::size_t reach() const { return bound ? probes : slots.size(); }
+
+    void grow() {
+        std::vector<slot> old(2 * slots.size());
+        stats::add(allocations);
+        old.swap(slots);
+        count = 0;
+        for(auto & s : old)
+            if(s.used)
+                insert(s.key, std::move(s.value));
+    }
+
+    std::size_t const bound;
+    std::size_t count = 0;
+    std::vector<slot> slots;
+};
+
+template<typename K, typename V, typename X = V>
+struct memo {
+    typedef X value_type;
+
+    std::function<X(memo_table<K, V> &)> run;
+
+    static memo unit(X x) {
+        return { [=](memo_table<K, V> &) { return x; } };
+    }
+};
+
+template<typename F, typename K, typename V, typename X>
+    MONADPLAY_REQUIRES(KleisliArrow<F, X>)
+kleisli_t<F, X> prod(F f, memo<K, V, X> m) {
+    return { [=](memo_table<K, V> & t) mutable {
+        X x = m.run(t);
+        stats::add(binds);
+        return hand_over(f, x).run(t);
+    } };
+}
+
+template<typename K, typename V, typename F>
+struct memoised {
+    F f;
+
+    memo<K, V> operator()(K k) const {
+        memoised self = *this;
+        return { [self, k](memo_table<K, V> & t) {
+            if(V const * v = t.find(k))
+                return *v;
+            V v = self.f(self, k).run(t);
+            t.insert(k, v);
+            return v;
+        } };
+    }
+};
+
+template<typename K, typename V, typename F>
+memoised<K, V, F> memo_fix(F f) { return { f }; }
+
+} // namespace monadplay
+
+#endif // MONADPLAY_MEMO_HPP
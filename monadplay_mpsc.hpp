@@ -0,0 +1,131 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_MPSC_HPP
+#define MONADPLAY_MPSC_HPP
+
+#include "monadplay.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+// monadplay: an append-only sequence many threads push into while one binds and folds over it.
+
+namespace monadplay {
+
+/* Step 9: a sequence several producer threads append to while a consumer binds
+           and folds over it, without taking a lock. A producer claims a slot
+           with a single fetch_add on "tail", constructs its element there and
+           then publishes the slot; slots live in fixed-size segments linked
+           in as they are needed, so appending never moves anything already
+           there. The consumer sees the "stable prefix", the slots up to the
+           first one not yet published, and "prod"/"foldl" over it behave just
+           as they do on a std::list holding the same elements ("unit" remains
+           the list's, since whatever an arrow returns is a std::list anyway).
+           Producers may still be appending, so arrows only ever get to see
+           the elements as X const &.
+           Being append-only, segments are freed with the sequence only.
+*/
+template<typename X, std::size_t N = 1024>
+class mpsc_list {
+public:
+    mpsc_list() : head(new segment(0)), last(head) { stats::add(allocations); }
+    mpsc_list(mpsc_list const &) = delete;
+    mpsc_list & operator=(mpsc_list const &) = delete;
+
+    ~mpsc_list() {
+        for(segment * s = head; s; ) {
+            for(std::size_t i = 0; i < N; ++i)
+                if(s->ready[i].load(std::memory_order_acquire))
+                    s->at(i)->~X();
+            segment * n = s->next.load(std::memory_order_acquire);
+            delete s;
+            s = n;
+        }
+    }
+
+    void push(X x) {
+        std::size_t i = tail.fetch_add(1, std::memory_order_relaxed);
+        segment * s = locate(i / N);
+        new (s->slot[i % N]) X(std::move(x));
+        s->ready[i % N].store(true, std::memory_order_release);
+    }
+
+    template<typename F>
+    void for_each_stable(F f) const {
+        for(segment * s = head; s; s = s->next.load(std::memory_order_acquire))
+            for(std::size_t i = 0; i < N; ++i)
+                if(s->ready[i].load(std::memory_order_acquire))
+                    f(static_cast<X const &>(*s->at(i)));
+                else
+                    return;
+    }
+
+private:
+    struct segment {
+        explicit segment(std::size_t k) : index(k) {
+            for(auto & r : ready)
+                r.store(false, std::memory_order_relaxed);
+        }
+        X * at(std::size_t i) { return reinterpret_cast<X *>(slot[i]); }
+
+        std::size_t const index;
+        std::atomic<segment *> next{nullptr};
+        std::atomic<bool> ready[N];
+        alignas(X) unsigned char slot[N][sizeof(X)];
+    };
+
+    // Walk to segment "k", linking in the missing ones on the way; a producer
+    // losing the race to link a segment simply adopts the winner's. "last" is
+    // only a hint to start from, segments never go away before the list does.
+    segment * locate(std::size_t k) {
+        segment * s = last.load(std::memory_order_acquire);
+        if(s->index > k)
+            s = head;
+        while(s->index < k) {
+            segment * n = s->next.load(std::memory_order_acquire);
+            if(!n) {
+                segment * fresh = new segment(s->index + 1);
+                stats::add(allocations);
+                if(s->next.compare_exchange_strong(n, fresh))
+                    n = fresh;
+                else
+                    delete fresh;
+            }
+            s = n;
+        }
+        segment * hint = last.load(std::memory_order_acquire);
+        while(hint->index < s->index && !last.compare_exchange_weak(hint, s))
+            ;
+        return s;
+    }
+
+    segment * const head;
+    std::atomic<segment *> last;
+    std::atomic<std::size_t> tail{0};
+};
+
+template<typename F, typename X, std::size_t N>
+    MONADPLAY_REQUIRES(KleisliArrow<F, X const>)
+kleisli_t<F, X const> prod(F f, mpsc_list<X, N> const & x) {
+    kleisli_t<F, X const> y;
+    std::size_t n = 0;
+    x.for_each_stable([&](X const & i) { y.splice(y.end(), f(i)); ++n; });
+    stats::add(binds, n);
+    return y;
+}
+
+template<typename F, typename X, typename Y, std::size_t N>
+    MONADPLAY_REQUIRES(Monoid<F, Y, X>)
+Y foldl(F f, mpsc_list<X, N> const & m, Y y) {
+    std::size_t n = 0;
+    m.for_each_stable([&](X const & i) { fold_step(f, y, i); ++n; });
+    stats::add(folds);
+    stats::add(elements, n);
+    return y;
+}
+
+} // namespace monadplay
+
+#endif // MONADPLAY_MPSC_HPP
@@ -0,0 +1,190 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_PROGRESSION_HPP
+#define MONADPLAY_PROGRESSION_HPP
+
+#include "monadplay.hpp"
+
+#include <array>
+
+// monadplay: symbolic progressions with closed-form sums.
+
+namespace monadplay {
+
+/* Step 24: a sequence that is nothing but a formula. A progression<T> of
+            "size" integers keeps the polynomial in the index i (of degree at
+            most "max_degree") giving its i-th element, so "iota" is the
+            polynomial first + step·i however long it is. Mapping a
+            "polynomial" arrow over it composes the two polynomials and stays
+            symbolic as long as the degree stays within bounds, and
+            "foldl(std::plus<>...)" is then a closed form: the sum over i < n
+            of i^k is a combination of binomials C(n, j + 1) (Stirling numbers
+            of the second kind times j!), each worked out exactly by dividing
+            the factorial out of the j + 1 factors before multiplying them.
+            All of it is done modulo 2^128, so the closed form agrees with
+            adding the elements one by one whenever every element fits in T
+            and the sum fits in the accumulator. The closed form is only taken
+            for std::plus<> or a std::plus over T or the accumulator's type,
+            since a narrower one truncates every addition. Past "max_degree",
+            through arrows it cannot see into, or for other folds, the
+            progression is materialised into a std::list and treated as one. Needs a compiler
+            with unsigned __int128 (GCC, Clang).
+*/
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 wide_t;
+
+inline wide_t choose(std::uint64_t n, unsigned m) {
+    if(n < m)
+        return 0;
+    std::uint64_t f[8];
+    for(unsigned j = 0; j < m; ++j)
+        f[j] = n - j;
+    for(std::uint64_t d = 2; d <= m; ++d) {
+        std::uint64_t g = d;
+        for(unsigned j = 0; g > 1 && j < m; ++j) {
+            std::uint64_t a = f[j], b = g;
+            while(b) {
+                std::uint64_t t = a % b;
+                a = b;
+                b = t;
+            }
+            f[j] /= a;
+            g /= a;
+        }
+    }
+    wide_t c = 1;
+    for(unsigned j = 0; j < m; ++j)
+        c *= f[j];
+    return c;
+}
+
+template<typename T>
+struct polynomial {
+    static_assert(std::is_integral<T>::value, "polynomials are over integers");
+    std::array<T, 5> c; // c[k] multiplies x^k
+
+    T operator()(T x) const {
+        T y = 0;
+        for(std::size_t k = c.size(); k-- > 0;)
+            y = y * x + c[k];
+        return y;
+    }
+};
+
+template<typename T>
+polynomial<T> affine(T a, T b) { return { { b, a } }; }
+
+template<typename T>
+struct progression {
+    static_assert(std::is_integral<T>::value, "progressions are over integers");
+    typedef T value_type;
+    enum : std::size_t { max_degree = 4 };
+
+    std::size_t size;
+    std::array<wide_t, max_degree + 1> coef; // while symbolic
+    bool symbolic;
+    std::list<T> items;                      // once materialised
+
+    static progression iota(std::size_t n, T first = 0, T step = 1)
+    { return { n, { { wide_t(first), wide_t(step) } }, true, {} }; }
+
+    static progression unit(T x) { return iota(1, x, 0); }
+
+    static progression of(std::list<T> x)
+    { std::size_t n = x.size(); return { n, {}, false, std::move(x) }; }
+
+    std::size_t degree() const {
+        std::size_t d = max_degree;
+        while(d > 0 && coef[d] == 0)
+            --d;
+        return d;
+    }
+
+    T at(std::size_t i) const {
+        if(!symbolic)
+            return *std::next(items.begin(), i);
+        wide_t y = 0;
+        for(std::size_t k = max_degree + 1; k-- > 0;)
+            y = y * i + coef[k];
+        return static_cast<T>(y);
+    }
+
+    std::list<T> materialise() const {
+        if(!symbolic)
+            return items;
+        std::list<T> x;
+        for(std::size_t i = 0; i < size; ++i)
+            x.push_back(at(i));
+        stats::add(allocations, size);
+        return x;
+    }
+
+    // The sum of all elements, modulo 2^128.
+    wide_t sum() const {
+        static constexpr std::uint64_t stirling[max_degree + 1][max_degree + 1] = {
+            { 1, 0,  0,  0,  0 },
+            { 0, 1,  0,  0,  0 },
+            { 0, 1,  2,  0,  0 },
+            { 0, 1,  6,  6,  0 },
+            { 0, 1, 14, 36, 24 } };
+        wide_t s = 0;
+        for(std::size_t k = 0; k <= max_degree; ++k)
+            for(std::size_t j = 0; j <= k; ++j)
+                s += coef[k] * stirling[k][j] * choose(size, unsigned(j + 1));
+        return s;
+    }
+};
+
+template<typename T>
+progression<T> fmap(polynomial<T> p, progression<T> m) {
+    stats::add(maps);
+    std::size_t dp = 0;
+    for(std::size_t k = 0; k < p.c.size(); ++k)
+        if(p.c[k] != 0)
+            dp = k;
+    if(!m.symbolic || dp * m.degree() > progression<T>::max_degree)
+        return progression<T>::of(fmap(p, m.materialise()));
+    // Horner over polynomials: r = (...(c[dp]·q + c[dp-1])·q + ...) + c[0]
+    std::array<wide_t, progression<T>::max_degree + 1> r{};
+    for(std::size_t k = dp + 1; k-- > 0;) {
+        std::array<wide_t, progression<T>::max_degree + 1> t{};
+        for(std::size_t a = 0; a <= progression<T>::max_degree; ++a)
+            for(std::size_t b = 0; a + b <= progression<T>::max_degree; ++b)
+                t[a + b] += r[a] * m.coef[b];
+        t[0] += wide_t(p.c[k]);
+        r = t;
+    }
+    m.coef = r;
+    return m;
+}
+
+template<typename F, typename T> MONADPLAY_REQUIRES(std::invocable<F &, T &>)
+std::list<kleisli_t<F, T>> fmap(F f, progression<T> const & m) {
+    return fmap(f, m.materialise());
+}
+
+template<typename F, typename T> MONADPLAY_REQUIRES(KleisliArrow<F, T>)
+kleisli_t<F, T> prod(F f, progression<T> const & m) {
+    return prod(f, m.materialise());
+}
+
+template<typename U, typename T, typename Y>
+Y foldl(std::plus<U> f, progression<T> const & m, Y y) {
+    bool const exact = std::is_void<U>::value || std::is_same<U, T>::value || std::is_same<U, Y>::value;
+    if(!m.symbolic || !exact || std::is_floating_point<Y>::value)
+        return foldl(f, m.materialise(), y);
+    stats::add(folds);
+    stats::add(elements, m.size);
+    return static_cast<Y>(y + static_cast<Y>(m.sum()));
+}
+
+template<typename F, typename T, typename Y> MONADPLAY_REQUIRES(Monoid<F, Y, T>)
+Y foldl(F f, progression<T> const & m, Y y) {
+    return foldl(f, m.materialise(), std::move(y));
+}
+#endif
+
+} // namespace monadplay
+
+#endif // MONADPLAY_PROGRESSION_HPP
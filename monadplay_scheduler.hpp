@@ -0,0 +1,335 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_SCHEDULER_HPP
+#define MONADPLAY_SCHEDULER_HPP
+
+#include "monadplay.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// monadplay: the work-stealing scheduler, NUMA placement and the parallel prod, fmap and reduce.
+
+namespace monadplay {
+
+/* Step 12: running thousands of small pipelines a second, a thread (or a
+            std::async) per pipeline costs more than the pipeline itself. The
+            scheduler multiplexes tasks onto a few workers, each owning a run
+            queue: a worker pushes and pops at the back of its own queue (what
+            it spawned is still warm in its cache) and, once that is empty,
+            steals from the front of the others', sleeping when there is
+            nothing to run anywhere. Spawning from outside the workers deals
+            tasks out round-robin. A spawn only takes the scheduler-wide lock
+            and wakes a worker when some worker is asleep, so while they are
+            all busy spawners contend on nothing but the queue they push to.
+
+            On machines with more than one NUMA node, "placement" asks for the
+            workers to be pinned to cores, dealt out across the nodes in turn.
+            Every worker pins itself before doing anything else, so whatever it
+            allocates (the results of the arrows it runs, its own bookkeeping)
+            is first touched, and so placed by the kernel, on its own node; the
+            constructor waits for them and "pinned" tells how many made it. The
+            input chunks stay where the caller allocated them: the combinators
+            below go over each of them once, and copying a chunk over first
+            would read it from its node all the same.
+*/
+struct placement {
+    bool pin = false;
+};
+
+// The cores this process may run on, taking one core from every NUMA node in
+// turn (as the kernel lists them in /sys, which is what libnuma reads too).
+inline std::vector<int> numa_cpu_order() {
+    std::vector<int> order;
+#ifdef __linux__
+    cpu_set_t allowed;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return order;
+    std::vector<std::vector<int>> nodes;
+    for(int n = 0; ; ++n) {
+        std::string path = "/sys/devices/system/node/node"
+                         + std::to_string(n) + "/cpulist";
+        FILE * fp = fopen(path.c_str(), "r");
+        if(!fp)
+            break;
+        nodes.emplace_back();
+        int a, b, c = ',';
+        while(c == ',' && fscanf(fp, "%d", &a) == 1) {
+            b = a;
+            if((c = fgetc(fp)) == '-' && fscanf(fp, "%d", &b) == 1)
+                c = fgetc(fp);
+            for(int i = a; i <= b; ++i)
+                if(i < CPU_SETSIZE && CPU_ISSET(i, &allowed))
+                    nodes.back().push_back(i);
+        }
+        fclose(fp);
+    }
+    if(nodes.empty()) {
+        nodes.emplace_back();
+        for(int i = 0; i < CPU_SETSIZE; ++i)
+            if(CPU_ISSET(i, &allowed))
+                nodes.back().push_back(i);
+    }
+    for(std::size_t k = 0, added = 1; added; ++k) {
+        added = 0;
+        for(auto & cpus : nodes)
+            if(k < cpus.size()) {
+                order.push_back(cpus[k]);
+                ++added;
+            }
+    }
+#endif
+    return order;
+}
+
+// Pins the calling thread to "cpu"; false if that is not supported or failed.
+inline bool pin_thread(int cpu) {
+#ifdef __linux__
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(cpu, &one);
+    return pthread_setaffinity_np(pthread_self(), sizeof(one), &one) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+class scheduler {
+public:
+    explicit scheduler( std::size_t n = std::thread::hardware_concurrency()
+                      , placement p = placement() ) {
+        n = std::max<std::size_t>(n, 1);
+        for(std::size_t i = 0; i < n; ++i)
+            queues.emplace_back(new queue);
+        std::vector<int> cpus = p.pin ? numa_cpu_order() : std::vector<int>();
+        for(std::size_t i = 0; i < n; ++i)
+            workers.emplace_back([this, i, cpu = cpus.empty() ? -1 : cpus[i % cpus.size()]]() {
+                run(i, cpu);
+            });
+        std::unique_lock<std::mutex> l(m);
+        wake.wait(l, [&]() { return started == n; });
+    }
+
+    scheduler(scheduler const &) = delete;
+    scheduler & operator=(scheduler const &) = delete;
+
+    // Whatever was spawned still runs to completion before the workers exit.
+    ~scheduler() {
+        {
+            std::lock_guard<std::mutex> l(m);
+            done = true;
+        }
+        wake.notify_all();
+        for(auto & w : workers)
+            w.join();
+    }
+
+    void spawn(std::function<void()> t) {
+        auto const & me = self();
+        std::size_t i = me.first == this
+            ? me.second
+            : next.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        pending.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> l(queues[i]->m);
+            queues[i]->q.push_back(std::move(t));
+        }
+        // Pairs with the increment of "sleeping" in run(): either the worker
+        // sees the task pending, or this sees the worker going to sleep and
+        // notifies it once it waits (it holds "m" until then).
+        if(sleeping.load() == 0)
+            return;
+        { std::lock_guard<std::mutex> l(m); }
+        wake.notify_one();
+    }
+
+    std::size_t size() const { return queues.size(); }
+    std::size_t pinned() const { return pinned_workers.load(std::memory_order_relaxed); }
+
+private:
+    struct queue {
+        std::mutex m;
+        std::deque<std::function<void()>> q;
+    };
+
+    static std::pair<scheduler const *, std::size_t> & self() {
+        static thread_local std::pair<scheduler const *, std::size_t> s{};
+        return s;
+    }
+
+    bool take(std::size_t i, std::function<void()> & t) {
+        for(std::size_t j = 0; j < queues.size(); ++j) {
+            queue & v = *queues[(i + j) % queues.size()];
+            std::lock_guard<std::mutex> l(v.m);
+            if(v.q.empty())
+                continue;
+            if(j == 0) {
+                t = std::move(v.q.back());
+                v.q.pop_back();
+            } else {
+                t = std::move(v.q.front());
+                v.q.pop_front();
+            }
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void run(std::size_t i, int cpu) {
+        if(cpu >= 0 && pin_thread(cpu))
+            pinned_workers.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> l(m);
+            ++started;
+        }
+        wake.notify_all();
+        self() = std::make_pair(this, i);
+        std::function<void()> t;
+        for(;;) {
+            if(take(i, t)) {
+                t();
+                continue;
+            }
+            std::unique_lock<std::mutex> l(m);
+            sleeping.fetch_add(1);
+            wake.wait(l, [&]() { return done || pending.load() > 0; });
+            sleeping.fetch_sub(1);
+            if(done && pending.load() == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> pending{0}, next{0}, pinned_workers{0}, sleeping{0};
+    std::size_t started = 0;
+    bool done = false;
+    std::mutex m;
+    std::condition_variable wake;
+};
+
+/* Step 13: "prod", "fmap" and a "reduce" for the scheduler. None of them waits:
+            the list is cut into chunks of "grain" elements (a grain of zero is
+            taken as one), every chunk is a task of its own, and the
+            continuation "k" is resumed with the result by whichever task
+            happens to finish last; pipelines are chained by binding again
+            inside "k", and a "progress" given to them hears of every chunk
+            done. A "cancel_token" given to them is looked at as every chunk
+            starts: chunks starting after it is cancelled are skipped, and "k"
+            gets what the others computed. Both have to live until "k" is
+            resumed. For "reduce_async", "f" must be associative with "y" as
+            its identity, since chunks are folded separately and their partial
+            results then folded in order.
+*/
+template<typename X>
+std::vector<std::list<X>> chunks(std::list<X> x, std::size_t grain) {
+    std::vector<std::list<X>> v;
+    grain = std::max<std::size_t>(grain, 1);
+    while(!x.empty()) {
+        auto e = x.begin();
+        std::advance(e, std::min(grain, x.size()));
+        v.emplace_back();
+        v.back().splice(v.back().end(), x, x.begin(), e);
+    }
+    return v;
+}
+
+template<typename F, typename X, typename K> MONADPLAY_REQUIRES(KleisliArrow<F, X>)
+void prod_async( scheduler & s, F f, std::list<X> x, K k
+               , std::size_t grain = cancel_token::batch, progress * p = nullptr
+               , cancel_token const * c = nullptr ) {
+    typedef kleisli_t<F, X> M;
+    struct state {
+        state(std::vector<std::list<X>> v, K k)
+            : in(std::move(v)), out(in.size()), left(in.size()), k(std::move(k)) {}
+
+        std::vector<std::list<X>> in;
+        std::vector<M> out;
+        std::atomic<std::size_t> left;
+        K k;
+    };
+    auto v = chunks(std::move(x), grain);
+    if(v.empty())
+        return s.spawn([k]() mutable { k(M{}); });
+    auto st = std::make_shared<state>(std::move(v), std::move(k));
+    for(std::size_t i = 0; i < st->in.size(); ++i)
+        s.spawn([st, f, i, p, c]() mutable {
+            if(!c || !c->cancelled()) {
+                for(auto & e : st->in[i])
+                    st->out[i].splice(st->out[i].end(), hand_over(f, e));
+                stats::add(binds, st->in[i].size());
+                if(p)
+                    p->advance(st->in[i].size());
+            }
+            if(st->left.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            M y;
+            for(auto & o : st->out)
+                y.splice(y.end(), o);
+            st->k(std::move(y));
+        });
+}
+
+template<typename F, typename X, typename K>
+    MONADPLAY_REQUIRES(std::invocable<F &, X &> || std::invocable<F &, X>)
+void fmap_async( scheduler & s, F f, std::list<X> x, K k
+               , std::size_t grain = cancel_token::batch, progress * p = nullptr
+               , cancel_token const * c = nullptr ) {
+    stats::add(maps);
+    prod_async( s, [f](X & y) mutable { return unit(hand_over(f, y)); }, std::move(x), std::move(k)
+              , grain, p, c );
+}
+
+template<typename F, typename X, typename Y, typename K> MONADPLAY_REQUIRES(Monoid<F, Y, X>)
+void reduce_async( scheduler & s, F f, std::list<X> x, Y y, K k
+                 , std::size_t grain = cancel_token::batch, progress * p = nullptr
+                 , cancel_token const * c = nullptr ) {
+    struct state {
+        state(std::vector<std::list<X>> v, Y const & y, K k)
+            : in(std::move(v)), out(in.size(), y), left(in.size()), k(std::move(k)) {}
+
+        std::vector<std::list<X>> in;
+        std::vector<Y> out;
+        std::atomic<std::size_t> left;
+        K k;
+    };
+    stats::add(folds);
+    auto v = chunks(std::move(x), grain);
+    if(v.empty())
+        return s.spawn([k, y]() mutable { k(std::move(y)); });
+    auto st = std::make_shared<state>(std::move(v), y, std::move(k));
+    for(std::size_t i = 0; i < st->in.size(); ++i)
+        s.spawn([st, f, y, i, p, c]() mutable {
+            if(!c || !c->cancelled()) {
+                for(auto & e : st->in[i])
+                    fold_step(f, st->out[i], e);
+                stats::add(elements, st->in[i].size());
+                if(p)
+                    p->advance(st->in[i].size());
+            }
+            if(st->left.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            for(auto & o : st->out)
+                fold_step(f, y, o);
+            st->k(std::move(y));
+        });
+}
+
+} // namespace monadplay
+
+#endif // MONADPLAY_SCHEDULER_HPP
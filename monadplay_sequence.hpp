@@ -0,0 +1,93 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_SEQUENCE_HPP
+#define MONADPLAY_SEQUENCE_HPP
+
+#include "monadplay_lazy.hpp"
+
+#include <future>
+#include <vector>
+
+// monadplay: sequence and traverse over lists, futures and lazy cells.
+
+namespace monadplay {
+
+/* Step 19: "sequence" turns a list of effects into an effect of a list, and
+            "traverse" runs an arrow over a list and does the same, which would
+            otherwise be written with "foldl" by hand each time. A std::list
+            of zero or one elements doubles as an optional, so for lists the
+            result is every combination of one element out of each (no result
+            at all as soon as one of them is empty). Results are collected in
+            std::vectors sized up front. An arrow returning futures has every
+            element already running by the time they are sequenced, so the
+            independent elements of a traversal are evaluated in parallel,
+            while lazy cells are only forced, all together, once needed.
+*/
+template<typename X>
+std::list<std::vector<X>> sequence(std::list<std::list<X>> const & m) {
+    std::list<std::vector<X>> y;
+    std::size_t n = 1;
+    for(auto & i : m)
+        n *= i.size();
+    if(n == 0)
+        return y;
+    std::vector<typename std::list<X>::const_iterator> at;
+    at.reserve(m.size());
+    for(auto & i : m)
+        at.push_back(i.begin());
+    for(;;) {
+        std::vector<X> v;
+        v.reserve(m.size());
+        for(auto & i : at)
+            v.push_back(*i);
+        y.push_back(std::move(v));
+        stats::add(allocations, 1 + !m.empty());
+        auto l = m.rbegin();
+        std::size_t k = at.size();
+        for(; k > 0; --k, ++l)
+            if(++at[k - 1] != l->end())
+                break;
+            else
+                at[k - 1] = l->begin();
+        if(k == 0)
+            return y;
+    }
+}
+
+template<typename X>
+std::future<std::vector<X>> sequence(std::list<std::future<X>> m) {
+    return std::async(std::launch::deferred, [](std::list<std::future<X>> m) {
+        std::vector<X> y;
+        y.reserve(m.size());
+        for(auto & i : m)
+            y.push_back(i.get());
+        stats::add(allocations, !m.empty());
+        return y;
+    }, std::move(m));
+}
+
+template<typename X>
+lazy<std::vector<X>> sequence(std::list<lazy<X>> m) {
+    return lazy<std::vector<X>>([m]() {
+        std::vector<X> y;
+        y.reserve(m.size());
+        for(auto & i : m)
+            y.push_back(force(i));
+        stats::add(allocations, !m.empty());
+        return y;
+    });
+}
+
+template<typename F, typename X> MONADPLAY_REQUIRES(std::invocable<F &, X &> || std::invocable<F &, X>)
+auto traverse(F f, std::list<X> x) {
+    std::list<kleisli_t<F, X>> m;
+    for(auto & i : x)
+        m.push_back(hand_over(f, i));
+    stats::add(allocations, x.size());
+    return sequence(std::move(m));
+}
+
+} // namespace monadplay
+
+#endif // MONADPLAY_SEQUENCE_HPP
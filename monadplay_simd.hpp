@@ -0,0 +1,167 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_SIMD_HPP
+#define MONADPLAY_SIMD_HPP
+
+#include "monadplay.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// monadplay: fmap, foldl and zip_with over std::vector, dispatched on the instruction set at run time.
+
+namespace monadplay {
+
+/* Step 22: "fmap", "foldl" and "zip_with" over contiguous std::vectors, where
+            every element is next to the last and the loops can be vectorised.
+            How wide depends on the CPU the binary lands on, so each loop is
+            compiled once per instruction set level (plain, AVX2, AVX-512) and
+            the widest one the CPU supports is picked when first needed. The
+            loops are left to the compiler's vectoriser, which GCC only runs in
+            full from -O3 (or with -ftree-vectorize). For testing, "simd_force"
+            (or MONADPLAY_SIMD=scalar|avx2|avx512 in the environment, where any
+            other value means the widest) pins any level the CPU can run, so
+            every variant can be checked against the others on one machine.
+            Compilers other than GCC and Clang on x86 get the plain loops only.
+            Floating point sums are only vectorised when the compiler may
+            reassociate them.
+*/
+enum class simd_level { scalar, avx2, avx512 };
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MONADPLAY_SIMD_X86
+#define MONADPLAY_TARGET(isa) __attribute__((target(isa)))
+#define MONADPLAY_INLINE inline __attribute__((always_inline))
+#else
+#define MONADPLAY_TARGET(isa)
+#define MONADPLAY_INLINE inline
+#endif
+
+inline simd_level simd_supported() {
+#ifdef MONADPLAY_SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+        return simd_level::avx512;
+    if(__builtin_cpu_supports("avx2"))
+        return simd_level::avx2;
+#endif
+    return simd_level::scalar;
+}
+
+inline std::atomic<simd_level> & simd_active() {
+    static std::atomic<simd_level> level([]() {
+        simd_level best = simd_supported();
+        char const * forced = std::getenv("MONADPLAY_SIMD");
+        std::string name = forced ? forced : "";
+        simd_level want = name == "scalar" ? simd_level::scalar
+                        : name == "avx2"   ? simd_level::avx2
+                        : name == "avx512" ? simd_level::avx512
+                        : best;
+        return want < best ? want : best;
+    }());
+    return level;
+}
+
+inline bool simd_force(simd_level l) {
+    if(l > simd_supported())
+        return false;
+    simd_active().store(l, std::memory_order_relaxed);
+    return true;
+}
+
+template<typename F, typename X, typename Y>
+MONADPLAY_INLINE void fmap_loop(F & f, X const * x, Y * y, std::size_t n) {
+    for(std::size_t i = 0; i < n; ++i)
+        y[i] = f(x[i]);
+}
+
+template<typename F, typename X, typename Y>
+MONADPLAY_INLINE Y foldl_loop(F & f, X const * x, Y y, std::size_t n) {
+    for(std::size_t i = 0; i < n; ++i)
+        fold_step(f, y, x[i]);
+    return y;
+}
+
+template<typename F, typename X, typename Y, typename Z>
+MONADPLAY_INLINE void zip_loop(F & f, X const * x, Y const * y, Z * z, std::size_t n) {
+    for(std::size_t i = 0; i < n; ++i)
+        z[i] = f(x[i], y[i]);
+}
+
+#ifdef MONADPLAY_SIMD_X86
+template<typename F, typename X, typename Y>
+MONADPLAY_TARGET("avx2") void fmap_avx2(F & f, X const * x, Y * y, std::size_t n)
+{ fmap_loop(f, x, y, n); }
+
+template<typename F, typename X, typename Y>
+MONADPLAY_TARGET("avx512f") void fmap_avx512(F & f, X const * x, Y * y, std::size_t n)
+{ fmap_loop(f, x, y, n); }
+
+template<typename F, typename X, typename Y>
+MONADPLAY_TARGET("avx2") Y foldl_avx2(F & f, X const * x, Y y, std::size_t n)
+{ return foldl_loop(f, x, std::move(y), n); }
+
+template<typename F, typename X, typename Y>
+MONADPLAY_TARGET("avx512f") Y foldl_avx512(F & f, X const * x, Y y, std::size_t n)
+{ return foldl_loop(f, x, std::move(y), n); }
+
+template<typename F, typename X, typename Y, typename Z>
+MONADPLAY_TARGET("avx2") void zip_avx2(F & f, X const * x, Y const * y, Z * z, std::size_t n)
+{ zip_loop(f, x, y, z, n); }
+
+template<typename F, typename X, typename Y, typename Z>
+MONADPLAY_TARGET("avx512f") void zip_avx512(F & f, X const * x, Y const * y, Z * z, std::size_t n)
+{ zip_loop(f, x, y, z, n); }
+#endif
+
+template<typename F, typename X> MONADPLAY_REQUIRES(std::invocable<F &, X const &>)
+auto fmap(F f, std::vector<X> const & x) {
+    std::vector<std::decay_t<decltype(f(x[0]))>> y(x.size());
+    stats::add(maps);
+    stats::add(allocations, !y.empty());
+    switch(simd_active().load(std::memory_order_relaxed)) {
+#ifdef MONADPLAY_SIMD_X86
+    case simd_level::avx512: fmap_avx512(f, x.data(), y.data(), x.size()); break;
+    case simd_level::avx2:   fmap_avx2(f, x.data(), y.data(), x.size()); break;
+#endif
+    default:                 fmap_loop(f, x.data(), y.data(), x.size()); break;
+    }
+    return y;
+}
+
+template<typename F, typename X, typename Y> MONADPLAY_REQUIRES(Monoid<F, Y, X>)
+Y foldl(F f, std::vector<X> const & x, Y y) {
+    stats::add(folds);
+    stats::add(elements, x.size());
+    switch(simd_active().load(std::memory_order_relaxed)) {
+#ifdef MONADPLAY_SIMD_X86
+    case simd_level::avx512: return foldl_avx512(f, x.data(), std::move(y), x.size());
+    case simd_level::avx2:   return foldl_avx2(f, x.data(), std::move(y), x.size());
+#endif
+    default:                 return foldl_loop(f, x.data(), std::move(y), x.size());
+    }
+}
+
+template<typename F, typename X, typename Y>
+    MONADPLAY_REQUIRES(std::invocable<F &, X const &, Y const &>)
+auto zip_with(F f, std::vector<X> const & x, std::vector<Y> const & y) {
+    std::size_t n = std::min(x.size(), y.size());
+    std::vector<std::decay_t<decltype(f(x[0], y[0]))>> z(n);
+    stats::add(maps);
+    stats::add(allocations, !z.empty());
+    switch(simd_active().load(std::memory_order_relaxed)) {
+#ifdef MONADPLAY_SIMD_X86
+    case simd_level::avx512: zip_avx512(f, x.data(), y.data(), z.data(), n); break;
+    case simd_level::avx2:   zip_avx2(f, x.data(), y.data(), z.data(), n); break;
+#endif
+    default:                 zip_loop(f, x.data(), y.data(), z.data(), n); break;
+    }
+    return z;
+}
+
+} // namespace monadplay
+
+#endif // MONADPLAY_SIMD_HPP
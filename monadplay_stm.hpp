@@ -0,0 +1,187 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_STM_HPP
+#define MONADPLAY_STM_HPP
+
+#include "monadplay.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// monadplay: software transactional memory.
+
+namespace monadplay {
+
+/* Step 14: software transactional memory, for arrows that run in parallel yet
+            must update shared state. A tvar is a shared variable carrying a
+            version; an stm<X> is a transaction computing an X, and "prod"
+            composes transactions into a bigger one, "unit" being the one that
+            touches nothing. "atomically" runs it against a private log: reads
+            are checked against the version of the global clock it started at,
+            writes are kept aside, and committing takes ownership of the
+            written tvars by compare-and-swap in address order, validates the
+            reads and publishes the writes under a fresh version. Nobody ever
+            blocks: a transaction failing to take a tvar, or seeing a read go
+            stale, is simply run again (this is TL2, with the owner bit in the
+            version word). "retry" gives up voluntarily until others commit.
+            Values live in std::atomic, so they must be trivially copyable.
+*/
+struct tvar_base {
+    std::atomic<uint64_t> stamp{0};   // version << 1 | owned-by-a-commit
+};
+
+template<typename T>
+struct tvar : tvar_base {
+    explicit tvar(T x) : value(x) {}
+    std::atomic<T> value;
+};
+
+struct stm_conflict {};
+struct stm_retry {};
+
+inline std::atomic<uint64_t> & stm_clock() {
+    static std::atomic<uint64_t> c{0};
+    return c;
+}
+
+class transaction {
+public:
+    explicit transaction(uint64_t rv) : rv(rv) {}
+
+    template<typename T>
+    T read(tvar<T> & v) {
+        if(pending * w = logged(&v))
+            return *static_cast<T const *>(w->x.get());
+        uint64_t s = v.stamp.load(std::memory_order_acquire);
+        T x = v.value.load(std::memory_order_acquire);
+        if((s & 1) || (s >> 1) > rv || v.stamp.load(std::memory_order_acquire) != s)
+            throw stm_conflict{};
+        reads.push_back(&v);
+        return x;
+    }
+
+    template<typename T>
+    void write(tvar<T> & v, T x) {
+        if(pending * w = logged(&v)) {
+            *static_cast<T *>(w->x.get()) = x;
+        } else {
+            stats::add(allocations);
+            writes.push_back(pending{ &v, std::make_shared<T>(x), 0
+                , [](tvar_base * b, void const * p) {
+                      // Release, so that a reader whose acquire load sees the
+                      // new value sees the locked stamp after it as well.
+                      static_cast<tvar<T> *>(b)->value.store(
+                          *static_cast<T const *>(p), std::memory_order_release);
+                  } });
+        }
+    }
+
+    bool commit() {
+        if(writes.empty())
+            return true;
+        std::sort( writes.begin(), writes.end()
+                 , [](pending const & a, pending const & b) { return a.v < b.v; } );
+        std::size_t owned = 0;
+        for(; owned < writes.size(); ++owned) {
+            pending & w = writes[owned];
+            w.stamp = w.v->stamp.load(std::memory_order_relaxed);
+            if((w.stamp & 1) || !w.v->stamp.compare_exchange_strong(w.stamp, w.stamp | 1))
+                return release(owned);
+        }
+        uint64_t wv = stm_clock().fetch_add(1) + 1;
+        for(auto r : reads) {
+            uint64_t s = r->stamp.load(std::memory_order_acquire);
+            if(((s & 1) && !logged(r)) || (s >> 1) > rv)
+                return release(owned);
+        }
+        for(auto & w : writes) {
+            w.publish(w.v, w.x.get());
+            w.v->stamp.store(wv << 1, std::memory_order_release);
+        }
+        return true;
+    }
+
+private:
+    struct pending {
+        tvar_base * v;
+        std::shared_ptr<void> x;
+        uint64_t stamp;
+        void (*publish)(tvar_base *, void const *);
+    };
+
+    pending * logged(tvar_base const * v) {
+        for(auto & w : writes)
+            if(w.v == v)
+                return &w;
+        return nullptr;
+    }
+
+    bool release(std::size_t owned) {
+        for(std::size_t i = 0; i < owned; ++i)
+            writes[i].v->stamp.store(writes[i].stamp, std::memory_order_release);
+        return false;
+    }
+
+    uint64_t const rv;
+    std::vector<tvar_base const *> reads;
+    std::vector<pending> writes;
+};
+
+template<typename X>
+struct stm {
+    typedef X value_type;
+
+    std::function<X(transaction &)> run;
+
+    static stm unit(X x) {
+        return { [=](transaction &) { return x; } };
+    }
+};
+
+template<typename T>
+stm<T> read_tvar(tvar<T> & v) {
+    return { [&v](transaction & t) { return t.read(v); } };
+}
+
+template<typename T>
+stm<T> write_tvar(tvar<T> & v, T x) {
+    return { [&v, x](transaction & t) { t.write(v, x); return x; } };
+}
+
+template<typename X>
+stm<X> retry() {
+    return { [](transaction &) -> X { throw stm_retry{}; } };
+}
+
+template<typename F, typename X> MONADPLAY_REQUIRES(KleisliArrow<F, X>)
+kleisli_t<F, X> prod(F f, stm<X> m) {
+    return { [=](transaction & t) mutable {
+        X x = m.run(t);
+        stats::add(binds);
+        return hand_over(f, x).run(t);
+    } };
+}
+
+template<typename X>
+X atomically(stm<X> const & m) {
+    for(;;) {
+        transaction t(stm_clock().load(std::memory_order_acquire));
+        try {
+            X x = m.run(t);
+            if(t.commit())
+                return x;
+        } catch(stm_conflict const &) {
+        } catch(stm_retry const &) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+} // namespace monadplay
+
+#endif // MONADPLAY_STM_HPP
@@ -0,0 +1,139 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_STREAM_HPP
+#define MONADPLAY_STREAM_HPP
+
+#include "monadplay.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// monadplay: push-based streams and the bounded channels that feed them.
+
+namespace monadplay {
+
+/* Step 10: the list monad is pull-and-materialise; event sources push instead.
+            A stream<X> is nothing but what it does to a subscriber: it pushes
+            its elements into it one at a time, the subscriber answering false
+            once it wants no more, and "subscribe" tells whether the stream ran
+            to its end. Since "unit" cannot be overloaded on what it returns,
+            instances other than std::list spell it stream<X>::unit; "prod" and
+            "fmap" keep their meaning, while "foldl" becomes a scan: a stream
+            of the running accumulator, one per element.
+*/
+template<typename X>
+struct stream {
+    typedef X value_type;
+    typedef std::function<bool(X const &)> subscriber;
+
+    std::function<bool(subscriber const &)> subscribe;
+
+    static stream unit(X x) {
+        return { [=](subscriber const & k) { return k(x); } };
+    }
+};
+
+template<typename F, typename X> MONADPLAY_REQUIRES(KleisliArrow<F, X const>)
+kleisli_t<F, X const> prod(F f, stream<X> m) {
+    typedef typename kleisli_t<F, X const>::subscriber subscriber;
+    return { [=](subscriber const & k) mutable {
+        return m.subscribe([&](X const & x) { stats::add(binds); return f(x).subscribe(k); });
+    } };
+}
+
+template<typename F, typename X> MONADPLAY_REQUIRES(std::invocable<F &, X const &>)
+auto fmap(F f, stream<X> m) {
+    typedef stream<std::decay_t<decltype(f(std::declval<X const &>()))>> S;
+    stats::add(maps);
+    return S{ [=](typename S::subscriber const & k) mutable {
+        return m.subscribe([&](X const & x) { return k(f(x)); });
+    } };
+}
+
+template<typename F, typename X, typename Y> MONADPLAY_REQUIRES(Monoid<F, Y, X>)
+stream<Y> foldl(F f, stream<X> m, Y y) {
+    stats::add(folds);
+    return { [=](typename stream<Y>::subscriber const & k) mutable {
+        Y s = y;
+        return m.subscribe([&](X const & x) {
+            stats::add(elements);
+            fold_step(f, s, x);
+            return k(s);
+        });
+    } };
+}
+
+/* Step 11: a channel is the bounded buffer between event sources and a stream.
+            "push" sleeps while the buffer is full, so a fast source is held
+            back by the pipeline instead of growing memory, and "try_push"
+            reports that backpressure to sources that would rather not wait.
+            The stream made by "from_channel" sleeps while the buffer is empty
+            and ends once the channel is closed and drained; nobody spins.
+*/
+template<typename X>
+class channel {
+public:
+    explicit channel(std::size_t capacity) : capacity(capacity) {}
+
+    bool push(X x) {
+        std::unique_lock<std::mutex> l(m);
+        not_full.wait(l, [&]() { return q.size() < capacity || closed; });
+        return enqueue(std::move(x));
+    }
+
+    bool try_push(X x) {
+        std::lock_guard<std::mutex> l(m);
+        return q.size() < capacity && enqueue(std::move(x));
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> l(m);
+        closed = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+    bool pop(X & x) {
+        std::unique_lock<std::mutex> l(m);
+        not_empty.wait(l, [&]() { return !q.empty() || closed; });
+        if(q.empty())
+            return false;
+        x = std::move(q.front());
+        q.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+private:
+    bool enqueue(X x) {
+        if(closed)
+            return false;
+        q.push_back(std::move(x));
+        not_empty.notify_one();
+        return true;
+    }
+
+    std::size_t const capacity;
+    std::deque<X> q;
+    bool closed = false;
+    std::mutex m;
+    std::condition_variable not_full, not_empty;
+};
+
+template<typename X>
+stream<X> from_channel(channel<X> & c) {
+    return { [&c](typename stream<X>::subscriber const & k) {
+        X x;
+        while(c.pop(x))
+            if(!k(x))
+                return false;
+        return true;
+    } };
+}
+
+} // namespace monadplay
+
+#endif // MONADPLAY_STREAM_HPP
@@ -0,0 +1,109 @@
+// Copyright (C) 2016 George Makrydakis <george@irrequietus.eu>
+// Licensed under MPLv2 (https://www.mozilla.org/en-US/MPL/2.0/)
+
+#ifndef MONADPLAY_ZIPPER_HPP
+#define MONADPLAY_ZIPPER_HPP
+
+#include "monadplay.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// monadplay: zippers, comonadic extend and stencils.
+
+namespace monadplay {
+
+/* Step 18: and now the dual. A zipper is a sequence with a focus: "extract"
+            reads the element in focus, and "extend" applies a function of a
+            whole zipper at every focus in turn, gathering the results into a
+            zipper of its own, the same focus kept. Storage is contiguous and
+            shared between a zipper and its refocused copies, so moving the
+            focus copies nothing; neighbours past either edge read as the edge
+            element. A fixed-radius stencil, the weights of the neighbours at
+            offsets -R..R, makes "extend" a weighted sum everywhere, and that
+            is lowered to one sliding pass per weight over the interior, plain
+            loops over contiguous arrays which compilers vectorise, with only
+            the R elements at each edge computed one position at a time.
+*/
+template<typename X>
+class zipper {
+public:
+    typedef X value_type;
+
+    explicit zipper(std::vector<X> v, std::size_t focus = 0)
+        : data(std::make_shared<std::vector<X> const>(std::move(v))), focus(focus)
+    { stats::add(allocations); }
+
+    X const & extract() const { return (*data)[focus]; }
+
+    X const & at(std::ptrdiff_t offset) const {
+        std::ptrdiff_t i = static_cast<std::ptrdiff_t>(focus) + offset;
+        std::ptrdiff_t last = static_cast<std::ptrdiff_t>(data->size()) - 1;
+        return (*data)[std::min(std::max(i, std::ptrdiff_t{0}), last)];
+    }
+
+    zipper refocus(std::size_t i) const { zipper z(*this); z.focus = i; return z; }
+
+    std::size_t position() const { return focus; }
+    std::size_t size() const { return data->size(); }
+    std::vector<X> const & storage() const { return *data; }
+
+private:
+    std::shared_ptr<std::vector<X> const> data;
+    std::size_t focus;
+};
+
+template<typename X>
+X const & extract(zipper<X> const & z) { return z.extract(); }
+
+template<typename F, typename X> MONADPLAY_REQUIRES(std::invocable<F &, zipper<X> const &>)
+auto extend(F f, zipper<X> const & z) {
+    typedef std::decay_t<decltype(f(z))> Y;
+    std::vector<Y> y;
+    y.reserve(z.size());
+    stats::add(allocations, z.size() != 0);
+    for(std::size_t i = 0; i < z.size(); ++i)
+        y.push_back(f(z.refocus(i)));
+    return zipper<Y>(std::move(y), z.position());
+}
+
+template<typename X, std::size_t R>
+struct stencil {
+    std::array<X, 2 * R + 1> w;
+};
+
+template<typename X, std::size_t R>
+zipper<X> extend(stencil<X, R> const & s, zipper<X> const & z) {
+    std::size_t const n = z.size();
+    std::vector<X> y(n, X{});
+    stats::add(allocations, n != 0);
+    X const * x = z.storage().data();
+    X * out = y.data();
+    if(n > 2 * R)
+        for(std::size_t k = 0; k <= 2 * R; ++k) {
+            X const w = s.w[k];
+            X const * in = x + k;
+            for(std::size_t i = R; i < n - R; ++i)
+                out[i] += w * in[i - R];
+        }
+    auto edge = [&](std::size_t i) {
+        zipper<X> here = z.refocus(i);
+        X v{};
+        for(std::size_t k = 0; k <= 2 * R; ++k)
+            v += s.w[k] * here.at(static_cast<std::ptrdiff_t>(k) - static_cast<std::ptrdiff_t>(R));
+        y[i] = v;
+    };
+    std::size_t const lo = std::min(R, n), hi = n > 2 * R ? n - R : lo;
+    for(std::size_t i = 0; i < lo; ++i)
+        edge(i);
+    for(std::size_t i = hi; i < n; ++i)
+        edge(i);
+    return zipper<X>(std::move(y), z.position());
+}
+
+} // namespace monadplay
+
+#endif // MONADPLAY_ZIPPER_HPP